@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: GPL-2.0
+/* ryzenadj --batch, newline delimited commands on one handle */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "batch.h"
+
+#define BATCH_LINE_SIZE 256
+#define BATCH_MAX_ARGS 4
+
+static const char *error_reason(const int err)
+{
+	switch (err) {
+	case ADJ_ERR_FAM_UNSUPPORTED: return "not supported on this family";
+	case ADJ_ERR_SMU_TIMEOUT: return "SMU timeout";
+	case ADJ_ERR_SMU_UNSUPPORTED: return "not supported on this SMU";
+	case ADJ_ERR_SMU_REJECTED: return "rejected by SMU";
+	case ADJ_ERR_MEMORY_ACCESS: return "memory access failed";
+	case ADJ_ERR_NOT_AVAILABLE: return "not available";
+	case ADJ_ERR_OUT_OF_MEMORY: return "out of memory";
+	case ADJ_ERR_SMU_UNAVAILABLE: return "SMU unavailable";
+	default: return "invalid argument";
+	}
+}
+
+static int split_args(char *line, char **argv)
+{
+	int argc = 0;
+	char *p;
+
+	for (p = strtok(line, " \t\r\n"); p && argc < BATCH_MAX_ARGS; p = strtok(NULL, " \t\r\n"))
+		argv[argc++] = p;
+
+	return p ? -1 : argc;
+}
+
+//first get or dump before any refresh reads the table once
+static int ensure_table(ryzen_access ry)
+{
+	return get_table_values(ry) ? 0 : init_table(ry);
+}
+
+static int do_set(ryzen_access ry, FILE *out, int argc, char **argv)
+{
+	const int setting = argc > 1 ? find_setting_by_name(argv[1]) : -1;
+	unsigned long value = 0;
+	char *end = NULL;
+	int err;
+
+	if (setting < 0 || argc != (is_setting_switch(setting) ? 2 : 3))
+		return ADJ_ERR_INVALID_ARG;
+	if (argc > 2) {
+		value = strtoul(argv[2], &end, 0);
+		if (*end || value > UINT32_MAX)
+			return ADJ_ERR_INVALID_ARG;
+	}
+
+	err = set_setting(ry, setting, (uint32_t)value);
+	if (!err)
+		fprintf(out, "ok\n");
+	return err;
+}
+
+static int do_get(ryzen_access ry, FILE *out, int argc, char **argv)
+{
+	const float *table;
+	unsigned long offset;
+	char *end;
+	int setting, err;
+	float value;
+
+	if (argc != 2)
+		return ADJ_ERR_INVALID_ARG;
+	err = ensure_table(ry);
+	if (err)
+		return err;
+
+	setting = find_setting_by_name(argv[1]);
+	if (setting >= 0) {
+		value = get_setting_limit(ry, setting);
+		if (isnan(value))
+			return ADJ_ERR_NOT_AVAILABLE;
+	} else {
+		offset = strtoul(argv[1], &end, 0);
+		if (*end || offset % 4 || offset >= get_table_size(ry))
+			return ADJ_ERR_INVALID_ARG;
+		table = get_table_values(ry);
+		value = table[offset / 4];
+	}
+
+	fprintf(out, "ok %.9g\n", value);
+	return 0;
+}
+
+void batch_write_table(ryzen_access ry, FILE *out, const char *tag)
+{
+	const float *table = get_table_values(ry);
+	const size_t count = get_table_size(ry) / 4;
+	size_t i;
+
+	fprintf(out, "%s %zu", tag, count);
+	for (i = 0; i < count; i++)
+		fprintf(out, " %.9g", table[i]);
+	fprintf(out, "\n");
+}
+
+static int do_dump(ryzen_access ry, FILE *out)
+{
+	const int err = ensure_table(ry);
+
+	if (!err)
+		batch_write_table(ry, out, "ok");
+	return err;
+}
+
+int batch_command(ryzen_access ry, FILE *out, char *line)
+{
+	char *argv[BATCH_MAX_ARGS];
+	int argc, err;
+
+	argc = split_args(line, argv);
+	if (!argc || argv[0][0] == '#')
+		return 0;
+
+	if (argc < 0)
+		err = ADJ_ERR_INVALID_ARG;
+	else if (!strcmp(argv[0], "quit"))
+		return 1;
+	else if (!strcmp(argv[0], "set"))
+		err = do_set(ry, out, argc, argv);
+	else if (!strcmp(argv[0], "get"))
+		err = do_get(ry, out, argc, argv);
+	else if (!strcmp(argv[0], "dump") && argc == 1)
+		err = do_dump(ry, out);
+	else if (!strcmp(argv[0], "refresh") && argc == 1) {
+		err = refresh_table(ry);
+		if (!err)
+			fprintf(out, "ok\n");
+	} else
+		err = ADJ_ERR_INVALID_ARG;
+
+	if (err)
+		fprintf(out, "error %d %s\n", err, error_reason(err));
+	return 0;
+}
+
+int run_batch(ryzen_access ry, FILE *in, FILE *out)
+{
+	char line[BATCH_LINE_SIZE];
+	size_t len;
+	int c;
+
+	//whatever was printed before the first answer goes first
+	fflush(out);
+	while (fgets(line, sizeof(line), in)) {
+		len = strlen(line);
+		if (len == sizeof(line) - 1 && line[len - 1] != '\n') {
+			//no command is that long, drop the rest of it
+			while ((c = fgetc(in)) != EOF && c != '\n')
+				;
+			fprintf(out, "error %d line too long\n", ADJ_ERR_INVALID_ARG);
+		} else if (batch_command(ry, out, line)) {
+			break;
+		}
+		//the client waits for every answer, a buffered one would stall it
+		if (fflush(out))
+			return ADJ_ERR_MEMORY_ACCESS;
+	}
+
+	return 0;
+}
@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: GPL-2.0
+/* ryzenadj --batch, newline delimited commands on one handle */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "lib/ryzenadj.h"
+
+/*
+ * Read commands from in until EOF or "quit", every one is answered by one line on out:
+ *   set <setting> [value]   ok | error <code> <reason>
+ *   get <setting>           ok <limit from the last refresh, units of set>
+ *   get <offset>            ok <PM table value at byte offset, e.g. 0x8>
+ *   refresh                 ok
+ *   dump                    ok <count> <value>...
+ * Settings are named like the options (fast-limit) or get_setting_name (fast_limit),
+ * switches take no value. Empty lines and lines starting with '#' are skipped.
+ * Values are printed with enough digits to read back the same float.
+ * Returns 0 or a negative error if out could not be written.
+ */
+int run_batch(ryzen_access ry, FILE *in, FILE *out);
+
+/* answer one command line, which is modified; returns 1 on "quit" */
+int batch_command(ryzen_access ry, FILE *out, char *line);
+/* the table of the last refresh as one "<tag> <count> <value>..." line */
+void batch_write_table(ryzen_access ry, FILE *out, const char *tag);
@@ -0,0 +1,31 @@
+import os, sys, time, subprocess, statistics
+
+# Startup time of `ryzenadj --info` with and without the init cache (--cache).
+# Usage: init-benchmark.py [path to ryzenadj] [runs]
+
+lib_path = os.path.dirname(os.path.abspath(__file__))
+os.chdir(lib_path)
+
+ryzenadj = sys.argv[1] if len(sys.argv) > 1 else os.path.join(lib_path, 'ryzenadj.exe' if sys.platform == 'win32' else 'ryzenadj')
+runs = int(sys.argv[2]) if len(sys.argv) > 2 else 50
+
+def run(args):
+    start = time.perf_counter()
+    result = subprocess.run([ryzenadj] + args, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    elapsed = (time.perf_counter() - start) * 1000
+    if result.returncode != 0:
+        sys.exit("{} {} failed with {}".format(ryzenadj, ' '.join(args), result.returncode))
+    return elapsed
+
+def bench(name, args):
+    times = sorted(run(args) for _ in range(runs))
+    p95 = times[min(len(times) - 1, int(len(times) * 0.95))]
+    print("{:<10} mean {:8.2f} ms   median {:8.2f} ms   p95 {:8.2f} ms".format(name, statistics.mean(times), statistics.median(times), p95))
+    return statistics.median(times)
+
+# populate the cache once, warm starts are what we want to measure
+run(['--info', '--cache'])
+
+cold = bench('no cache', ['--info'])
+warm = bench('cache', ['--info', '--cache'])
+print("speedup {:.1f}x".format(cold / warm if warm else float('inf')))
@@ -54,6 +54,7 @@ def enable(field):
         error = error_messages.get(res, "{:s} did fail with {:d}\n")
         sys.stderr.write(error.format(function_name, res));
 
+# `ryzenadj --hold=3000 --fast-limit=35000 ...` does the same natively and watches every applied limit
 print("Monitor if fast limit is not 35W")
 while True:
     lib.refresh_table(ry)
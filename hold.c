@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: GPL-2.0
+/* ryzenadj --hold, re-apply limits overridden by firmware or other tools */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+
+#include "loop.h"
+#include "hold.h"
+
+struct held_setting {
+	uint32_t value;                  /* what we applied */
+	float expected;                  /* limit the PM table showed after we applied it, NAN: not watchable */
+	uint32_t overrides;
+	int watched;
+};
+
+struct hold {
+	const uint32_t *values;
+	struct held_setting held[ADJ_SETTING_COUNT];
+};
+
+static void log_time(void)
+{
+	char buf[16];
+	const time_t now = time(NULL);
+
+	strftime(buf, sizeof(buf), "%H:%M:%S", localtime(&now));
+	printf("[%s] ", buf);
+}
+
+static void reapply(ryzen_access ry, const enum ryzen_setting setting, const uint32_t value)
+{
+	const int err = set_setting(ry, setting, value);
+
+	if (err)
+		printf("Failed to re-apply %s: %d\n", get_setting_name(setting), err);
+}
+
+static void CALL hold_check(ryzen_access ry, int result, void *ctx)
+{
+	struct hold *h = ctx;
+	struct held_setting *held;
+	int setting, overridden = 0;
+	float limit;
+
+	if (result) {
+		log_time();
+		printf("Unable to refresh power metric table: %d\n", result);
+		return;
+	}
+
+	for (setting = 0; setting < ADJ_SETTING_COUNT; setting++) {
+		held = &h->held[setting];
+		if (!held->watched)
+			continue;
+
+		limit = get_setting_limit(ry, setting);
+		if (isnan(limit) || fabsf(limit - held->expected) <= ADJ_LIMIT_TOLERANCE)
+			continue;
+
+		held->overrides++;
+		overridden++;
+		log_time();
+		printf("%s was overridden to %g, re-apply %u (override %u)\n", get_setting_name(setting), limit,
+		       held->value, held->overrides);
+		reapply(ry, setting, held->value);
+	}
+
+	//settings without a PM table field can't be watched, re-apply them along with any override
+	for (setting = 0; overridden && setting < ADJ_SETTING_COUNT; setting++) {
+		held = &h->held[setting];
+		if (h->values[setting] != (uint32_t)-1 && isnan(held->expected))
+			reapply(ry, setting, held->value);
+	}
+
+	fflush(stdout);
+}
+
+int run_hold(ryzen_access ry, const uint32_t *values, const uint32_t interval_ms)
+{
+	struct held_setting *held;
+	struct hold *h;
+	int setting, watched = 0;
+	int errorcode;
+
+	if (!interval_ms)
+		return ADJ_ERR_INVALID_ARG;
+
+	h = calloc(1, sizeof(*h));
+	if (!h)
+		return ADJ_ERR_OUT_OF_MEMORY;
+	h->values = values;
+
+	//the limits as they took effect, firmware may clamp what we asked for
+	errorcode = refresh_table(ry);
+	if (errorcode) {
+		printf("Unable to refresh power metric table: %d\n", errorcode);
+		free(h);
+		return errorcode;
+	}
+
+	for (setting = 0; setting < ADJ_SETTING_COUNT; setting++) {
+		held = &h->held[setting];
+		held->value = values[setting];
+		held->expected = NAN;
+		if (values[setting] == (uint32_t)-1)
+			continue;
+
+		held->expected = get_setting_limit(ry, setting);
+		held->watched = !isnan(held->expected);
+		if (held->watched)
+			watched++;
+		else
+			printf("%s has no PM table field, it is re-applied with overridden limits\n", get_setting_name(setting));
+	}
+
+	if (!watched) {
+		printf("None of the applied settings can be watched on PM table version %x\n", get_table_ver(ry));
+		free(h);
+		return ADJ_ERR_FAM_UNSUPPORTED;
+	}
+
+	printf("Holding %d limits, checking every %u ms\n", watched, interval_ms);
+	fflush(stdout);
+
+	//one table refresh per interval is the only SMU traffic unless something was overridden
+	ryzenadj_schedule_refresh(ry, interval_ms, hold_check, h);
+	run_loop(ry);
+	ryzenadj_schedule_refresh(ry, 0, NULL, NULL);
+
+	for (setting = 0; setting < ADJ_SETTING_COUNT; setting++) {
+		if (h->held[setting].overrides)
+			printf("%s: %u overrides\n", get_setting_name(setting), h->held[setting].overrides);
+	}
+
+	free(h);
+	return 0;
+}
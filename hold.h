@@ -0,0 +1,14 @@
+// SPDX-License-Identifier: GPL-2.0
+/* ryzenadj --hold, re-apply limits overridden by firmware or other tools */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "lib/ryzenadj.h"
+
+/*
+ * Watch the settings applied with values[setting] (-1: not applied) every interval_ms
+ * until SIGINT/SIGTERM, returns 0 or a negative error.
+ */
+int run_hold(ryzen_access ry, const uint32_t *values, uint32_t interval_ms);
@@ -1,10 +1,12 @@
 // SPDX-License-Identifier: LGPL
 /* Copyright (C) 2018-2019 Jiaxun Yang <jiaxun.yang@flygoat.com> */
 /* RyzenAdj API */
+#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "ryzenadj.h"
+#include "atomics.h"
 #include "math.h"
 
 #ifndef _WIN32
@@ -12,8 +14,144 @@
 #define Sleep(x) usleep((x)*1000)
 #endif
 
+static size_t known_table_size(const uint32_t table_ver)
+{
+	switch (table_ver) {
+		case 0x1E0001: return 0x568;
+		case 0x1E0002: return 0x580;
+		case 0x1E0003: return 0x578;
+		case 0x1E0004:
+		case 0x1E0005:
+		case 0x1E000A:
+		case 0x1E0101: return 0x608;
+		case 0x370000: return 0x794;
+		case 0x370001: return 0x884;
+		case 0x370002: return 0x88C;
+		case 0x370003:
+		case 0x370004: return 0x8AC;
+		case 0x370005: return 0x8C8;
+		case 0x3F0000: return 0x7AC;
+		case 0x400001: return 0x910;
+		case 0x400002: return 0x928;
+		case 0x400003: return 0x94C;
+		case 0x400004:
+		case 0x400005: return 0x944;
+		case 0x450004: return 0xAA4;
+		case 0x450005: return 0xAB0;
+		case 0x4C0003: return 0xB18;
+		case 0x4C0004: return 0xB1C;
+		case 0x4C0005: return 0xAF8;
+		case 0x4C0006: return 0xAFC;
+		case 0x4C0008: return 0xAF0;
+		case 0x4C0007:
+		case 0x4C0009: return 0xB00;
+		case 0x5D0008:
+		case 0x5D0009:
+		case 0x5D000B: return 0xD54;
+		case 0x64020c: return 0xE50;
 
-EXP ryzen_access CALL init_ryzenadj() {
+		// use a larger size then the largest known table to be able to test real table size of unknown tables
+		default: return 0x1000;
+	}
+}
+
+//the cache must describe a table layout this build knows, or the size ryzen_smu reports which init_table prefers
+static int plausible_table_size(const ryzen_access ry, const struct init_cache *entry)
+{
+	//init_table was not run yet, it requests version, size and address itself
+	if (!entry->table_addr)
+		return 1;
+	if (!entry->table_ver || !entry->table_size || entry->table_size % 4)
+		return 0;
+	if (entry->table_size == known_table_size(entry->table_ver))
+		return 1;
+#ifndef _WIN32
+	if (entry->smu_driver && entry->table_size == ry->os_access->access.kmod.pm_table_size)
+		return 1;
+#endif
+	return 0;
+}
+
+static int init_from_cache(ryzen_access ry)
+{
+	struct init_cache entry;
+	char boot_id[sizeof(entry.boot_id)];
+
+	if (init_cache_load(ry->init_cache, &entry))
+		return ADJ_ERR_NOT_AVAILABLE;
+
+	//everything in the cache is stable until the next boot
+	if (get_boot_id(boot_id, sizeof(boot_id)) || strcmp(boot_id, entry.boot_id) ||
+	    entry.cpuid != cpuid_get_signature() || entry.smu_driver != is_using_smu_driver() ||
+	    entry.family != ry->family) {
+		DBG("init cache is outdated\n");
+		return ADJ_ERR_NOT_AVAILABLE;
+	}
+
+	if (!plausible_table_size(ry, &entry)) {
+		DBG("init cache has an unexpected PM table size\n");
+		return ADJ_ERR_NOT_AVAILABLE;
+	}
+
+	//mailboxes which were never probed stay lazy, get_smu_at refuses layouts not of this family
+	if (entry.mailbox[TYPE_MP1][0])
+		ry->mp1_smu = get_smu_at(ry->os_access, TYPE_MP1, entry.mailbox[TYPE_MP1][0],
+					 entry.mailbox[TYPE_MP1][1], entry.mailbox[TYPE_MP1][2], &ry->smu_ctx);
+	if (entry.mailbox[TYPE_PSMU][0])
+		ry->psmu = get_smu_at(ry->os_access, TYPE_PSMU, entry.mailbox[TYPE_PSMU][0],
+				      entry.mailbox[TYPE_PSMU][1], entry.mailbox[TYPE_PSMU][2], &ry->smu_ctx);
+	if ((entry.mailbox[TYPE_MP1][0] && !ry->mp1_smu) || (entry.mailbox[TYPE_PSMU][0] && !ry->psmu)) {
+		free_smu(ry->mp1_smu);
+		free_smu(ry->psmu);
+		ry->mp1_smu = ry->psmu = NULL;
+		return ADJ_ERR_NOT_AVAILABLE;
+	}
+
+	ry->bios_if_ver = entry.bios_if_ver;
+	ry->table_ver = entry.table_ver;
+	ry->table_size = (size_t)entry.table_size;
+	ry->table_addr = (uintptr_t)entry.table_addr;
+	return 0;
+}
+
+static void update_init_cache(ryzen_access ry)
+{
+	struct init_cache entry;
+
+	if (!ry->init_cache)
+		return;
+
+	memset(&entry, 0, sizeof(entry));
+	if (get_boot_id(entry.boot_id, sizeof(entry.boot_id)))
+		return;
+
+	entry.cpuid = cpuid_get_signature();
+	entry.smu_driver = is_using_smu_driver();
+	entry.family = ry->family;
+	//only store what is known, don't probe anything just for the cache
+	entry.bios_if_ver = ry->bios_if_ver;
+	if (ry->mp1_smu) {
+		entry.mailbox[TYPE_MP1][0] = ry->mp1_smu->msg;
+		entry.mailbox[TYPE_MP1][1] = ry->mp1_smu->rep;
+		entry.mailbox[TYPE_MP1][2] = ry->mp1_smu->arg_base;
+	}
+	if (ry->psmu) {
+		entry.mailbox[TYPE_PSMU][0] = ry->psmu->msg;
+		entry.mailbox[TYPE_PSMU][1] = ry->psmu->rep;
+		entry.mailbox[TYPE_PSMU][2] = ry->psmu->arg_base;
+	}
+	entry.table_ver = ry->table_ver;
+	entry.table_size = ry->table_size;
+	entry.table_addr = ry->table_addr;
+	init_cache_save(ry->init_cache, &entry);
+}
+
+//CPU time spent inside the library, taken at public entry points only so nothing is counted twice
+#define _account_cpu_begin() const uint64_t cpu_start_ns = get_thread_cpu_time_ns()
+#define _account_cpu_end(RY) atomic_fetch_add_u64(&(RY)->smu_ctx.counters.cpu_ns, get_thread_cpu_time_ns() - cpu_start_ns)
+
+static ryzen_access init_ryzenadj_internal(const char *init_cache) {
+	_account_cpu_begin();
 	const enum ryzen_family family = cpuid_get_family();
 	ryzen_access ry;
 
@@ -23,50 +161,99 @@ EXP ryzen_access CALL init_ryzenadj() {
 	ry = (ryzen_access)malloc(sizeof(*ry));
 
 	if (!ry){
-		printf("Out of memory\n");
+		ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_OUT_OF_MEMORY, "Out of memory");
 		return NULL;
 	}
 
 	memset(ry, 0, sizeof(*ry));
 
 	ry->family = family;
+	resolve_smu_ops(family, ry->ops);
+	ry->smu_ctx.starvation_ns = SMU_STARVATION_NS_DEFAULT;
 	//init version and power metric table only on demand to avoid unnecessary SMU writes
 	ry->bios_if_ver = 0;
 	ry->table_values = NULL;
 
 	ry->os_access = init_os_access_obj();
 	if(!ry->os_access){
-		printf("Unable to get os_access Obj, check permission\n");
+		ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_MEMORY_ACCESS, "Unable to get os_access Obj, check permission");
 		return NULL;
 	}
+	get_syscall_cost(ry->os_access, &ry->smu_ctx.syscall_cost);
 
-	ry->mp1_smu = get_smu(ry->os_access, TYPE_MP1);
-	if(!ry->mp1_smu){
-		printf("Unable to get MP1 SMU Obj\n");
-		goto err_exit;
+	//MP1 and PSMU mailboxes are probed on first use by get_mailbox
+	if (init_cache) {
+		ry->init_cache = strdup(init_cache);
+		if (ry->init_cache)
+			init_from_cache(ry);
 	}
 
-	ry->psmu = get_smu(ry->os_access, TYPE_PSMU);
-	if(!ry->psmu){
-		printf("Unable to get RSMU Obj\n");
-		goto err_exit;
+	_account_cpu_end(ry);
+	return ry;
+}
+
+EXP ryzen_access CALL init_ryzenadj() {
+	return init_ryzenadj_internal(NULL);
+}
+
+EXP ryzen_access CALL init_ryzenadj_cached(const char *path) {
+	char default_path[CACHE_PATH_MAX];
+
+	if (!path) {
+		if (cache_file_path("init", default_path, sizeof(default_path)))
+			return init_ryzenadj_internal(NULL);
+		path = default_path;
 	}
 
-	return ry;
+	return init_ryzenadj_internal(path);
+}
 
-err_exit:
-	cleanup_ryzenadj(ry);
-	return NULL;
+static smu_t get_mailbox(ryzen_access ry, const enum SMU_TYPE type)
+{
+	smu_t *smu = type == TYPE_MP1 ? &ry->mp1_smu : &ry->psmu;
+
+	if (*smu || ry->smu_unavailable[type])
+		return *smu;
+
+	*smu = get_smu(ry->os_access, type, &ry->smu_ctx);
+	if (!*smu) {
+		ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_SMU_UNAVAILABLE, "Unable to get %s SMU Obj", type == TYPE_MP1 ? "MP1" : "RSMU");
+		//remember the failure, probing again would only repeat the timeout
+		ry->smu_unavailable[type] = 1;
+		return NULL;
+	}
+
+	update_init_cache(ry);
+	return *smu;
 }
 
 EXP void CALL cleanup_ryzenadj(ryzen_access ry) {
+	struct smu_request *req, *next;
+	int i;
+
 	if (ry == NULL)
 	    return;
 
-	free(ry->mp1_smu);
-	free(ry->psmu);
+	//workers must be gone before their mailboxes
+	for (i = 0; i < TYPE_COUNT; i++) {
+		smu_queue_stop(ry->queue[i]);
+		for (req = smu_queue_take_done(ry->queue[i]); req; req = next) {
+			next = req->next;
+			free(req);
+		}
+		smu_queue_free(ry->queue[i]);
+	}
+
+	free_smu(ry->mp1_smu);
+	free_smu(ry->psmu);
 	free_os_access_obj(ry->os_access);
+	table_history_free(ry->history);
+	table_stats_free(ry->stats);
+	free(ry->capability_cache);
+	free(ry->init_cache);
 	free(ry->table_values);
+	os_wait_obj_free(ry->wait_obj);
+	trace_ring_free(ry->smu_ctx.trace);
 	free(ry);
 }
 
@@ -80,42 +267,45 @@ EXP int get_bios_if_ver(ryzen_access ry)
 	if(ry->bios_if_ver)
 		return ry->bios_if_ver;
 
+	smu_t smu = get_mailbox(ry, TYPE_MP1);
+	if(!smu)
+		return 0;
+
 	smu_service_args_t args = {0, 0, 0, 0, 0, 0};
-	smu_service_req(ry->mp1_smu, 0x3, &args);
+	smu_service_req(smu, CLASS_TELEMETRY, 0x3, &args);
 	ry->bios_if_ver = args.arg0;
 	return ry->bios_if_ver;
 }
 
-#define _return_translated_smu_error(SMU_RESP)                              \
-do {                                                                        \
-	if (SMU_RESP == REP_MSG_UnknownCmd) {                                   \
-		printf("%s is unsupported\n", __func__);                            \
-		return ADJ_ERR_SMU_UNSUPPORTED;                                     \
-	} else if (SMU_RESP == REP_MSG_CmdRejectedPrereq){                      \
-		printf("%s was rejected\n", __func__);                              \
-		return ADJ_ERR_SMU_REJECTED;                                        \
-	} else if (SMU_RESP == REP_MSG_CmdRejectedBusy) {                       \
-		printf("%s was rejected - busy\n", __func__);                       \
-		return ADJ_ERR_SMU_REJECTED;                                        \
-	} else if (SMU_RESP == REP_MSG_Failed) {                                \
-		printf("%s failed\n", __func__);                                    \
-		return ADJ_ERR_SMU_REJECTED;                                        \
-	} else {                                                                \
-		printf("%s failed with unknown response %x\n", __func__, SMU_RESP); \
-		return ADJ_ERR_SMU_REJECTED;                                        \
-	}                                                                       \
+#define _return_translated_smu_error(SMU_RESP)                                                     \
+do {                                                                                               \
+	if (SMU_RESP == REP_MSG_UnknownCmd) {                                                          \
+		ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_SMU_UNSUPPORTED, "%s is unsupported", __func__);           \
+		return ADJ_ERR_SMU_UNSUPPORTED;                                                            \
+	} else if (SMU_RESP == REP_MSG_CmdRejectedPrereq){                                             \
+		ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_SMU_REJECTED, "%s was rejected", __func__);                \
+		return ADJ_ERR_SMU_REJECTED;                                                               \
+	} else if (SMU_RESP == REP_MSG_CmdRejectedBusy) {                                              \
+		ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_SMU_REJECTED, "%s was rejected - busy", __func__);         \
+		return ADJ_ERR_SMU_REJECTED;                                                               \
+	} else if (SMU_RESP == REP_MSG_Failed) {                                                       \
+		ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_SMU_REJECTED, "%s failed", __func__);                      \
+		return ADJ_ERR_SMU_REJECTED;                                                               \
+	} else {                                                                                       \
+		ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_SMU_REJECTED, "%s failed with unknown response %x",        \
+			__func__, SMU_RESP);                                                                   \
+		return ADJ_ERR_SMU_REJECTED;                                                               \
+	}                                                                                              \
 } while (0);
 
-static int request_table_ver_and_size(ryzen_access ry) {
-	unsigned int get_table_ver_msg;
-	int resp;
-
-	switch (ry->family) {
+//PSMU message for the PM table version, 0 for families without PM table support
+static unsigned int table_ver_msg(const enum ryzen_family family)
+{
+	switch (family) {
 		case FAM_RAVEN:
 		case FAM_PICASSO:
 		case FAM_DALI:
-			get_table_ver_msg = 0xC;
-			break;
+			return 0xC;
 		case FAM_RENOIR:
 		case FAM_LUCIENNE:
 		case FAM_CEZANNE:
@@ -125,60 +315,36 @@ static int request_table_ver_and_size(ryzen_access ry) {
 		case FAM_KRACKANPOINT:
 		case FAM_STRIXPOINT:
 		case FAM_STRIXHALO:
-			get_table_ver_msg = 0x6;
-			break;
+			return 0x6;
 		default:
-			printf("request_table_ver_and_size is not supported on this family\n");
-			return ADJ_ERR_FAM_UNSUPPORTED;
+			return 0;
+	}
+}
+
+static int request_table_ver_and_size(ryzen_access ry) {
+	const unsigned int get_table_ver_msg = table_ver_msg(ry->family);
+	int resp;
+
+	if (!get_table_ver_msg) {
+		ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_FAM_UNSUPPORTED, "request_table_ver_and_size is not supported on this family");
+		return ADJ_ERR_FAM_UNSUPPORTED;
 	}
 
+	smu_t psmu = get_mailbox(ry, TYPE_PSMU);
+	if(!psmu)
+		return ADJ_ERR_SMU_UNAVAILABLE;
+
 	smu_service_args_t args = {0, 0, 0, 0, 0, 0};
-	resp = smu_service_req(ry->psmu, get_table_ver_msg, &args);
+	resp = smu_service_req(psmu, CLASS_TELEMETRY, get_table_ver_msg, &args);
 	ry->table_ver = args.arg0;
 
-	switch (ry->table_ver) {
-		case 0x1E0001: ry->table_size = 0x568; break;
-		case 0x1E0002: ry->table_size = 0x580; break;
-		case 0x1E0003: ry->table_size = 0x578; break;
-		case 0x1E0004:
-		case 0x1E0005:
-		case 0x1E000A:
-		case 0x1E0101: ry->table_size = 0x608; break;
-		case 0x370000: ry->table_size = 0x794; break;
-		case 0x370001: ry->table_size = 0x884; break;
-		case 0x370002: ry->table_size = 0x88C; break;
-		case 0x370003:
-		case 0x370004: ry->table_size = 0x8AC; break;
-		case 0x370005: ry->table_size = 0x8C8; break;
-		case 0x3F0000: ry->table_size = 0x7AC; break;
-		case 0x400001: ry->table_size = 0x910; break;
-		case 0x400002: ry->table_size = 0x928; break;
-		case 0x400003: ry->table_size = 0x94C; break;
-		case 0x400004:
-		case 0x400005: ry->table_size = 0x944; break;
-		case 0x450004: ry->table_size = 0xAA4; break;
-		case 0x450005: ry->table_size = 0xAB0; break;
-		case 0x4C0003: ry->table_size = 0xB18; break;
-		case 0x4C0004: ry->table_size = 0xB1C; break;
-		case 0x4C0005: ry->table_size = 0xAF8; break;
-		case 0x4C0006: ry->table_size = 0xAFC; break;
-		case 0x4C0008: ry->table_size = 0xAF0; break;
-		case 0x4C0007:
-		case 0x4C0009: ry->table_size = 0xB00; break;
-		case 0x5D0008:
-		case 0x5D0009:
-		case 0x5D000B: ry->table_size = 0xD54; break;
-		case 0x64020c: ry->table_size = 0xE50; break;
-
-		// use a larger size then the largest known table to be able to test real table size of unknown tables
-		default: ry->table_size = 0x1000; break;
-	}
+	ry->table_size = known_table_size(ry->table_ver);
 
 	if (resp != REP_MSG_OK) {
 		_return_translated_smu_error(resp);
 	}
 	if(!ry->table_ver){
-		printf("request_table_ver_and_size did not return anything\n");
+		ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_SMU_UNSUPPORTED, "request_table_ver_and_size did not return anything");
 		return ADJ_ERR_SMU_UNSUPPORTED;
 	}
 	return 0;
@@ -209,11 +375,15 @@ static int request_table_addr(ryzen_access ry)
 		get_table_addr_msg = 0x66;
 		break;
 	default:
-		printf("request_table_addr is not supported on this family\n");
+		ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_FAM_UNSUPPORTED, "request_table_addr is not supported on this family");
 		return ADJ_ERR_FAM_UNSUPPORTED;
 	}
 
-	resp = smu_service_req(ry->psmu, get_table_addr_msg, &args);
+	smu_t psmu = get_mailbox(ry, TYPE_PSMU);
+	if(!psmu)
+		return ADJ_ERR_SMU_UNAVAILABLE;
+
+	resp = smu_service_req(psmu, CLASS_TELEMETRY, get_table_addr_msg, &args);
 
 	switch (ry->family)
 	{
@@ -233,15 +403,19 @@ static int request_table_addr(ryzen_access ry)
 		_return_translated_smu_error(resp);
 	}
 	if(!ry->table_addr){
-		printf("request_table_addr did not return anything\n");
+		ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_SMU_UNSUPPORTED, "request_table_addr did not return anything");
 		return ADJ_ERR_SMU_UNSUPPORTED;
 	}
 	return 0;
 }
 
-static int request_transfer_table(ryzen_access ry)
+//delays before the 2nd and 3rd transfer table attempt after the SMU rejected it
+static const uint32_t transfer_retry_ms[] = { 10, 100 };
+#define TRANSFER_RETRIES (sizeof(transfer_retry_ms) / sizeof(transfer_retry_ms[0]))
+
+//one transfer table attempt, returns the SMU response or a negative error code
+static int send_transfer_table(ryzen_access ry)
 {
-	int resp;
 	unsigned int transfer_table_msg;
 	smu_service_args_t args = {0, 0, 0, 0, 0, 0};
 	switch (ry->family)
@@ -264,22 +438,51 @@ static int request_transfer_table(ryzen_access ry)
 		transfer_table_msg = 0x65;
 		break;
 	default:
-		printf("request_transfer_table is not supported on this family\n");
+		ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_FAM_UNSUPPORTED, "request_transfer_table is not supported on this family");
 		return ADJ_ERR_FAM_UNSUPPORTED;
 	}
 
-	resp = smu_service_req(ry->psmu, transfer_table_msg, &args);
-	if (resp == REP_MSG_CmdRejectedPrereq) {
-		//2nd try is needed for 2 usecase: if SMU got interrupted or first call after boot on Zen2
-		//we need to wait because if we don't wait 2nd call will fail, too: similar to Raven and Picasso issue but with real reject instead of 0 data response
-		//but because we don't have to check any physical memory values, don't waste CPU cycles and use sleep instead
-		Sleep(10);
-		resp = smu_service_req(ry->psmu, transfer_table_msg, &args);
-		if(resp == REP_MSG_CmdRejectedPrereq){
-			printf("request_transfer_table was rejected twice\n");
-			Sleep(100);
-			resp = smu_service_req(ry->psmu, transfer_table_msg, &args);
-		}
+	smu_t psmu = get_mailbox(ry, TYPE_PSMU);
+	if(!psmu)
+		return ADJ_ERR_SMU_UNAVAILABLE;
+
+	if(!ry->smu_ctx.trace)
+		return (int)smu_service_req(psmu, CLASS_TELEMETRY, transfer_table_msg, &args);
+
+	const uint64_t start_ns = get_monotonic_time_ns();
+	const uint32_t resp = smu_service_req(psmu, CLASS_TELEMETRY, transfer_table_msg, &args);
+	trace_record(ry->smu_ctx.trace, TRACE_TRANSFER, start_ns, get_monotonic_time_ns() - start_ns,
+		     TYPE_PSMU, CLASS_TELEMETRY, transfer_table_msg, 0, resp, 0);
+	return (int)resp;
+}
+
+//count and trace a retry, mailbox is where a setting falls back to
+static void note_retry(ryzen_access ry, const uint32_t what, const uint32_t mailbox, const uint32_t attempt, const uint32_t delay_ms)
+{
+	atomic_fetch_add_u64(&ry->smu_ctx.counters.retries, 1);
+	if(ry->smu_ctx.trace)
+		trace_record(ry->smu_ctx.trace, TRACE_RETRY, get_monotonic_time_ns(), 0, mailbox, 0, what,
+			     attempt, delay_ms, 0);
+}
+
+static int request_transfer_table(ryzen_access ry)
+{
+	uint32_t attempt;
+	int resp;
+
+	resp = send_transfer_table(ry);
+	//2nd try is needed for 2 usecase: if SMU got interrupted or first call after boot on Zen2
+	//we need to wait because if we don't wait 2nd call will fail, too: similar to Raven and Picasso issue but with real reject instead of 0 data response
+	//but because we don't have to check any physical memory values, don't waste CPU cycles and use sleep instead
+	for(attempt = 0; resp == REP_MSG_CmdRejectedPrereq && attempt < TRANSFER_RETRIES; attempt++){
+		if(attempt)
+			ADJ_LOG(LOG_LEVEL_WARN, ADJ_ERR_SMU_REJECTED, "request_transfer_table was rejected twice");
+		note_retry(ry, TRACE_RETRY_TRANSFER, TYPE_PSMU, attempt + 2, transfer_retry_ms[attempt]);
+		Sleep(transfer_retry_ms[attempt]);
+		resp = send_transfer_table(ry);
+	}
+	if(resp < 0){
+		return resp;
 	}
 	if(resp != REP_MSG_OK){
 		_return_translated_smu_error(resp);
@@ -287,24 +490,29 @@ static int request_transfer_table(ryzen_access ry)
 	return 0;
 }
 
-EXP int CALL init_table(ryzen_access ry)
+//everything init_table does before the first transfer, without any sleep
+static int setup_table(ryzen_access ry)
 {
-	DBG("init_table\n");
 	int errorcode = 0;
+	int learned = 0;
 
-	errorcode = request_table_ver_and_size(ry);
-	if(errorcode){
-		return errorcode;
-	}
+	//table version, size and address may already be known from the init cache
+	if(!ry->table_addr){
+		errorcode = request_table_ver_and_size(ry);
+		if(errorcode){
+			return errorcode;
+		}
 
-	errorcode = request_table_addr(ry);
-	if(errorcode){
-		return errorcode;
+		errorcode = request_table_addr(ry);
+		if(errorcode){
+			return errorcode;
+		}
+		learned = 1;
 	}
 
 	//init memory object because it is prerequiremt to woring with physical memory address
 	if (init_mem_obj(ry->os_access, ry->table_addr) < 0) {
-		printf("Unable to get memory access\n");
+		ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_MEMORY_ACCESS, "Unable to get memory access");
 		return ADJ_ERR_MEMORY_ACCESS;
 	}
 
@@ -322,8 +530,29 @@ EXP int CALL init_table(ryzen_access ry)
 
 	//hold copy of table value in memory for our single value getters
 	ry->table_values = calloc(ry->table_size / 4, 4);
+	if(!ry->table_values){
+		return ADJ_ERR_OUT_OF_MEMORY;
+	}
+
+	if(learned)
+		update_init_cache(ry);
+
+	return 0;
+}
+
+static int refresh_table_internal(ryzen_access ry);
+
+static int init_table_internal(ryzen_access ry)
+{
+	DBG("init_table\n");
+	int errorcode = 0;
+
+	errorcode = setup_table(ry);
+	if(errorcode){
+		return errorcode;
+	}
 
-	errorcode = refresh_table(ry);
+	errorcode = refresh_table_internal(ry);
 	if(errorcode)
 	{
 		return errorcode;
@@ -337,12 +566,21 @@ EXP int CALL init_table(ryzen_access ry)
 		//transfer, wait, transfer; does work
 		DBG("empty table detected, try again\n");
 		Sleep(10);
-		return refresh_table(ry);
+		return refresh_table_internal(ry);
 	}
 
 	return 0;
 }
 
+EXP int CALL init_table(ryzen_access ry)
+{
+	_account_cpu_begin();
+	const int errorcode = init_table_internal(ry);
+
+	_account_cpu_end(ry);
+	return errorcode;
+}
+
 #define _lazy_init_table(RETURN_VAR)                                 \
 do {                                                                 \
 	if(!ry->table_values) {                                          \
@@ -373,10 +611,39 @@ EXP float* CALL get_table_values(ryzen_access ry)
 	return ry->table_values;
 }
 
-EXP int CALL refresh_table(ryzen_access ry)
+static int copy_table(ryzen_access ry, const uint64_t now)
+{
+	int errorcode = copy_pm_table(ry->os_access, ry->table_values, ry->table_size);
+
+	if(ry->smu_ctx.trace)
+		trace_record(ry->smu_ctx.trace, TRACE_COPY, now, get_monotonic_time_ns() - now, TYPE_PSMU, 0,
+			     (uint32_t)ry->table_size, 0, (uint32_t)errorcode, 0);
+	atomic_fetch_add_u64(&ry->smu_ctx.counters.syscalls, ry->smu_ctx.syscall_cost.pm_table_copy);
+	if(errorcode){
+		ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_MEMORY_ACCESS, "refresh_table failed");
+		return ADJ_ERR_MEMORY_ACCESS;
+	}
+	atomic_fetch_add_u64(&ry->smu_ctx.counters.bytes_copied, ry->table_size);
+	atomic_fetch_add_u64(&ry->smu_ctx.counters.refreshes, 1);
+
+	if(ry->history)
+		table_history_push(ry->history, ry->table_values, now);
+	if(ry->stats)
+		table_stats_update(ry->stats, ry->table_values, now);
+
+	return 0;
+}
+
+static int refresh_table_internal(ryzen_access ry)
 {
 	int errorcode = 0;
-	_lazy_init_table(errorcode);
+
+	//like _lazy_init_table, without accounting init_table twice
+	if(!ry->table_values) {
+		DBG("warning: %s was called before init_table\n", __func__);
+		errorcode = init_table_internal(ry);
+		if(errorcode) return errorcode;
+	}
 
 	//only execute request table if we don't use SMU driver
 	if(!is_using_smu_driver()){
@@ -394,1076 +661,1244 @@ EXP int CALL refresh_table(ryzen_access ry)
 		return errorcode;
 	}
 
-	if(copy_pm_table(ry->os_access, ry->table_values, ry->table_size)){
-		printf("refresh_table failed\n");
-		return ADJ_ERR_MEMORY_ACCESS;
-	}
-
-	return 0;
+	return copy_table(ry, get_monotonic_time_ns());
 }
 
-#define _do_adjust(OPT) \
-do {                                                 \
-	smu_service_args_t args = {0, 0, 0, 0, 0, 0};    \
-	int resp;										 \
-	args.arg0 = value;                               \
-	resp = smu_service_req(ry->mp1_smu, OPT, &args); \
-	if (resp == REP_MSG_OK) {                        \
-		err = 0;                                     \
-	} else if (resp == REP_MSG_UnknownCmd) {         \
-		err = ADJ_ERR_SMU_UNSUPPORTED;               \
-	} else {                                         \
-		err = ADJ_ERR_SMU_REJECTED;                  \
-	}                                                \
-} while (0);
+EXP int CALL refresh_table(ryzen_access ry)
+{
+	_account_cpu_begin();
+	const int errorcode = refresh_table_internal(ry);
 
+	_account_cpu_end(ry);
+	return errorcode;
+}
 
-#define _do_adjust_psmu(OPT) \
-do {                                                 \
-	smu_service_args_t args = {0, 0, 0, 0, 0, 0};    \
-	int resp;										 \
-	args.arg0 = value;                               \
-	resp = smu_service_req(ry->psmu, OPT, &args);    \
-	if (resp == REP_MSG_OK) {                        \
-		err = 0;                                     \
-	} else if (resp == REP_MSG_UnknownCmd) {         \
-		err = ADJ_ERR_SMU_UNSUPPORTED;               \
-	} else {                                         \
-		err = ADJ_ERR_SMU_REJECTED;                  \
-	}                                                \
-} while (0);
+static int schedule_transfer_retry(ryzen_access ry, uint64_t now, uint32_t delay_ms, uint32_t *retry_after_ms)
+{
+	ry->transfer_retry_at = now + (uint64_t)delay_ms * 1000000;
+	if(retry_after_ms)
+		*retry_after_ms = delay_ms;
+	return ADJ_ERR_WOULD_BLOCK;
+}
 
-#define _read_float_value(OFFSET)                    \
-do {                                                 \
-	if(!ry->table_values)                            \
-		return NAN;                                  \
-	return ry->table_values[(OFFSET) / 4];           \
-} while (0);
+static int refresh_table_nb_internal(ryzen_access ry, uint32_t *retry_after_ms)
+{
+	const uint64_t now = get_monotonic_time_ns();
+	int errorcode, resp;
 
+	if(retry_after_ms)
+		*retry_after_ms = 0;
 
-EXP int CALL set_stapm_limit(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+	if(!ry->table_values){
+		errorcode = setup_table(ry);
+		if(errorcode){
+			return errorcode;
+		}
+	}
 
-	/* \_SB.ALIB (0x0c, [size, 0x05, val]) */
+	//a previous call already scheduled the next attempt
+	if(ry->transfer_retry_at > now){
+		if(retry_after_ms)
+			*retry_after_ms = (uint32_t)((ry->transfer_retry_at - now + 999999) / 1000000);
+		return ADJ_ERR_WOULD_BLOCK;
+	}
+	ry->transfer_retry_at = 0;
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x1a);
-		break;
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-	case FAM_CEZANNE:
-	case FAM_VANGOGH:
-	case FAM_REMBRANDT:
-	case FAM_MENDOCINO:
-	case FAM_PHOENIX:
-	case FAM_HAWKPOINT:
-	case FAM_KRACKANPOINT:
-	case FAM_STRIXPOINT:
-	case FAM_STRIXHALO:
-		_do_adjust(0x14);
-		if (err) {
-			printf("%s: Retry with PSMU\n", __func__);
-				_do_adjust_psmu(0x31);
+	//same conditions as refresh_table, a pending retry always transfers
+	if(!is_using_smu_driver() &&
+	   (ry->transfer_attempt || ry->table_values[0] == 0 || compare_pm_table(ry->table_values, 6 * 4) == 0)){
+		resp = send_transfer_table(ry);
+		if(resp < 0){
+			ry->transfer_attempt = 0;
+			return resp;
+		}
+		if(resp == REP_MSG_CmdRejectedPrereq && ry->transfer_attempt < TRANSFER_RETRIES){
+			note_retry(ry, TRACE_RETRY_TRANSFER, TYPE_PSMU, ry->transfer_attempt + 2,
+				    transfer_retry_ms[ry->transfer_attempt]);
+			return schedule_transfer_retry(ry, now, transfer_retry_ms[ry->transfer_attempt++], retry_after_ms);
+		}
+		ry->transfer_attempt = 0;
+		if(resp != REP_MSG_OK){
+			_return_translated_smu_error(resp);
 		}
-		break;
-	case FAM_DRAGONRANGE:
-	case FAM_FIRERANGE:
-		_do_adjust(0x4f);
-		break;
-	default:
-		break;
 	}
-	return err;
-}
 
-EXP int CALL set_fast_limit(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+	errorcode = copy_table(ry, now);
+	if(errorcode){
+		return errorcode;
+	}
 
-	/* \_SB.ALIB (0x0c, [size, 0x06, val]) */
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x1b);
-		break;
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-	case FAM_CEZANNE:
-	case FAM_VANGOGH:
-	case FAM_REMBRANDT:
-	case FAM_MENDOCINO:
-	case FAM_PHOENIX:
-	case FAM_HAWKPOINT:
-	case FAM_KRACKANPOINT:
-	case FAM_STRIXPOINT:
-	case FAM_STRIXHALO:
-		_do_adjust(0x15);
-		break;
-	case FAM_DRAGONRANGE:
-	case FAM_FIRERANGE:
-		_do_adjust(0x3e);
-		break;
-	default:
-		break;
+	//Raven and Picasso answer the very first transfer after boot with an empty table, see init_table
+	if(!ry->table_values[0] && !ry->empty_table_retried){
+		ry->empty_table_retried = 1;
+		return schedule_transfer_retry(ry, now, 10, retry_after_ms);
 	}
-	return err;
+
+	return 0;
 }
 
-EXP int CALL set_slow_limit(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+EXP int CALL refresh_table_nb(ryzen_access ry, uint32_t *retry_after_ms)
+{
+	_account_cpu_begin();
+	const int errorcode = refresh_table_nb_internal(ry, retry_after_ms);
 
-	/* \_SB.ALIB (0x0c, [size, 0x07, val]) */
+	_account_cpu_end(ry);
+	return errorcode;
+}
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x1c);
-		break;
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-	case FAM_CEZANNE:
-	case FAM_VANGOGH:
-	case FAM_REMBRANDT:
-	case FAM_MENDOCINO:
-	case FAM_PHOENIX:
-	case FAM_HAWKPOINT:
-	case FAM_KRACKANPOINT:
-	case FAM_STRIXPOINT:
-	case FAM_STRIXHALO:
-		_do_adjust(0x16);
-		break;
-	case FAM_DRAGONRANGE:
-	case FAM_FIRERANGE:
-		_do_adjust(0x5f);
-		break;
-	default:
-		break;
-	}
-	return err;
+static int complete_async_settings(ryzen_access ry);
+
+//earliest time dispatch has work to do, 0 for none
+static uint64_t next_deadline(ryzen_access ry)
+{
+	uint64_t deadline = ry->transfer_retry_at;
+
+	if(ry->refresh_interval_ms && ry->next_refresh && (!deadline || ry->next_refresh < deadline))
+		deadline = ry->next_refresh;
+
+	return deadline;
 }
 
-EXP int CALL set_slow_time(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+static uint32_t arm_next_deadline(ryzen_access ry, const uint64_t now)
+{
+	const uint64_t deadline = next_deadline(ry);
 
-	/* \_SB.ALIB (0x0c, [size, 0x08, val]) */
+	if(ry->wait_obj)
+		os_wait_obj_arm(ry->wait_obj, deadline);
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x1d);
-		break;
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-	case FAM_CEZANNE:
-	case FAM_VANGOGH:
-	case FAM_REMBRANDT:
-	case FAM_MENDOCINO:
-	case FAM_PHOENIX:
-	case FAM_HAWKPOINT:
-	case FAM_KRACKANPOINT:
-	case FAM_STRIXPOINT:
-	case FAM_STRIXHALO:
-		_do_adjust(0x17);
-		break;
-	case FAM_DRAGONRANGE:
-	case FAM_FIRERANGE:
-		_do_adjust(0x60);
-		break;
-	default:
-		break;
+	if(!deadline)
+		return UINT32_MAX;
+	if(deadline <= now)
+		return 0;
+	return (uint32_t)((deadline - now + 999999) / 1000000);
+}
+
+EXP intptr_t CALL ryzenadj_get_fd(ryzen_access ry)
+{
+	if(!ry->wait_obj){
+		ry->wait_obj = os_wait_obj_init();
+		if(!ry->wait_obj)
+			return ADJ_ERR_NOT_AVAILABLE;
+		arm_next_deadline(ry, get_monotonic_time_ns());
 	}
-	return err;
+
+	return os_wait_obj_get_fd(ry->wait_obj);
 }
 
-EXP int CALL set_stapm_time(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+EXP int CALL ryzenadj_schedule_refresh(ryzen_access ry, uint32_t interval_ms, ryzen_refresh_cb callback, void *ctx)
+{
+	const uint64_t now = get_monotonic_time_ns();
 
-	/* \_SB.ALIB (0x0c, [size, 0x01, val]) */
+	ry->refresh_interval_ms = interval_ms;
+	ry->refresh_cb = callback;
+	ry->refresh_ctx = ctx;
+	//first refresh on the next dispatch
+	ry->next_refresh = now;
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x1e);
-		break;
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-	case FAM_CEZANNE:
-	case FAM_VANGOGH:
-	case FAM_REMBRANDT:
-	case FAM_MENDOCINO:
-	case FAM_PHOENIX:
-	case FAM_HAWKPOINT:
-	case FAM_KRACKANPOINT:
-	case FAM_STRIXPOINT:
-	case FAM_STRIXHALO:
-		_do_adjust(0x18);
-	case FAM_DRAGONRANGE:
-	case FAM_FIRERANGE:
-		_do_adjust(0x4e);
-	default:
-		break;
-	}
-	return err;
+	arm_next_deadline(ry, now);
+	return 0;
 }
 
-EXP int CALL set_tctl_temp(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
-
-	/* \_SB.ALIB (0x0c, [size, 0x03, val]) */
+EXP int CALL ryzenadj_dispatch(ryzen_access ry, uint32_t *timeout_ms)
+{
+	const uint64_t now = get_monotonic_time_ns();
+	int handled = 0;
+	int errorcode;
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x1f);
-		break;
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-	case FAM_CEZANNE:
-	case FAM_VANGOGH:
-	case FAM_REMBRANDT:
-	case FAM_MENDOCINO:
-	case FAM_PHOENIX:
-	case FAM_HAWKPOINT:
-	case FAM_KRACKANPOINT:
-	case FAM_STRIXPOINT:
-	case FAM_STRIXHALO:
-		_do_adjust(0x19);
-		break;
-	case FAM_DRAGONRANGE:
-	case FAM_FIRERANGE:
-		_do_adjust(0x3f);
-		break;
-	default:
-		break;
+	//clear first, wakeups during dispatch must stay pending
+	if(ry->wait_obj)
+		os_wait_obj_clear(ry->wait_obj);
+
+	if(ry->refresh_interval_ms && ry->next_refresh <= now && ry->transfer_retry_at <= now){
+		errorcode = refresh_table_nb(ry, NULL);
+		//on would block the retry deadline takes over, next_refresh stays due
+		if(errorcode != ADJ_ERR_WOULD_BLOCK){
+			const uint64_t period = (uint64_t)ry->refresh_interval_ms * 1000000;
+
+			//fixed grid, missed periods are skipped instead of bunched up
+			ry->next_refresh += ((now - ry->next_refresh) / period + 1) * period;
+			handled++;
+			if(ry->refresh_cb)
+				ry->refresh_cb(ry, errorcode, ry->refresh_ctx);
+		}
+	} else if(ry->transfer_retry_at && ry->transfer_retry_at <= now){
+		//retry of a refresh_table_nb called by the user, just wake them up
+		ry->transfer_retry_at = 0;
+		handled++;
 	}
-	return err;
-}
 
-EXP int CALL set_vrm_current(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+	handled += complete_async_settings(ry);
 
-	/* \_SB.ALIB (0x0c, [size, 0x0b, val]) */
+	if(timeout_ms)
+		*timeout_ms = arm_next_deadline(ry, get_monotonic_time_ns());
+	else
+		arm_next_deadline(ry, get_monotonic_time_ns());
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x20);
-		break;
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-	case FAM_CEZANNE:
-	case FAM_VANGOGH:
-	case FAM_REMBRANDT:
-	case FAM_MENDOCINO:
-	case FAM_PHOENIX:
-	case FAM_HAWKPOINT:
-	case FAM_KRACKANPOINT:
-	case FAM_STRIXPOINT:
-	case FAM_STRIXHALO:
-		_do_adjust(0x1a);
-		break;
-	case FAM_DRAGONRANGE:
-	case FAM_FIRERANGE:
-		_do_adjust(0x3c);
-		break;
-	default:
-		break;
-	}
-	return err;
+	return handled;
 }
 
-EXP int CALL set_vrmsoc_current(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+EXP int CALL enable_trace(ryzen_access ry, uint32_t capacity)
+{
+	if(!capacity)
+		return ADJ_ERR_INVALID_ARG;
 
-	/* \_SB.ALIB (0x0c, [size, 0x0e, val]) */
+	//not safe against requests in flight, like enable_table_history
+	trace_ring_free(ry->smu_ctx.trace);
+	ry->smu_ctx.trace = trace_ring_alloc(capacity);
+	if(!ry->smu_ctx.trace)
+		return ADJ_ERR_OUT_OF_MEMORY;
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x21);
-		break;
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-	case FAM_CEZANNE:
-	case FAM_VANGOGH:
-	case FAM_REMBRANDT:
-	case FAM_MENDOCINO:
-	case FAM_PHOENIX:
-	case FAM_HAWKPOINT:
-	case FAM_KRACKANPOINT:
-	case FAM_STRIXPOINT:
-	case FAM_STRIXHALO:
-		_do_adjust(0x1b);
-	default:
-		break;
-	}
-	return err;
+	return 0;
 }
 
-EXP int CALL set_vrmgfx_current(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
-
-	switch (ry->family)
-	{
-	case FAM_VANGOGH:
-		_do_adjust(0x1c);
-	default:
-		break;
-	}
-	return err;
+EXP void CALL disable_trace(ryzen_access ry)
+{
+	trace_ring_free(ry->smu_ctx.trace);
+	ry->smu_ctx.trace = NULL;
 }
 
-EXP int CALL set_vrmcvip_current(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+EXP int CALL export_trace_json(ryzen_access ry, const char *path)
+{
+	FILE *f;
+	int errorcode;
 
-	switch (ry->family)
-	{
-	case FAM_VANGOGH:
-		_do_adjust(0x1d);
-	default:
-		break;
-	}
-	return err;
+	if(!ry->smu_ctx.trace)
+		return ADJ_ERR_NOT_AVAILABLE;
+
+	f = fopen(path, "w");
+	if(!f)
+		return ADJ_ERR_MEMORY_ACCESS;
+
+	errorcode = trace_write_json(ry->smu_ctx.trace, f);
+	if(fclose(f))
+		errorcode = ADJ_ERR_MEMORY_ACCESS;
+	return errorcode;
 }
 
-EXP int CALL set_vrmmax_current(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+EXP int CALL enable_table_history(ryzen_access ry, uint32_t capacity, const uint32_t *offsets, uint32_t offset_count)
+{
+	int errorcode;
+	uint32_t i;
+	_lazy_init_table(errorcode);
 
-	/* \_SB.ALIB (0x0c, [size, 0x0c, val]) */
+	if(capacity < 2)
+		return ADJ_ERR_INVALID_ARG;
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x22);
-		break;
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-	case FAM_CEZANNE:
-	case FAM_REMBRANDT:
-	case FAM_MENDOCINO:
-	case FAM_PHOENIX:
-	case FAM_HAWKPOINT:
-	case FAM_KRACKANPOINT:
-	case FAM_STRIXPOINT:
-	case FAM_STRIXHALO:
-		_do_adjust(0x1c);
-		break;
-	case FAM_VANGOGH:
-		_do_adjust(0x1e);
-	default:
-		break;
+	for(i = 0; offsets && i < offset_count; i++){
+		if(offsets[i] % 4 || offsets[i] >= ry->table_size)
+			return ADJ_ERR_INVALID_ARG;
 	}
-	return err;
-}
 
-EXP int CALL set_vrmgfxmax_current(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+	//not safe against concurrent readers, history must be set up before any reader starts
+	table_history_free(ry->history);
+	ry->history = table_history_alloc(capacity, ry->table_size, offsets, offset_count);
+	if(!ry->history)
+		return ADJ_ERR_OUT_OF_MEMORY;
 
-	switch (ry->family)
-	{
-	case FAM_VANGOGH:
-		_do_adjust(0x1f);
-	default:
-		break;
-	}
-	return err;
+	return 0;
 }
 
-EXP int CALL set_vrmsocmax_current(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+EXP void CALL disable_table_history(ryzen_access ry)
+{
+	table_history_free(ry->history);
+	ry->history = NULL;
+}
 
-	/* \_SB.ALIB (0x0c, [size, 0x11, val]) */
+EXP uint64_t CALL get_table_history_seq(ryzen_access ry)
+{
+	if(!ry->history)
+		return 0;
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x23);
-		break;
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-	case FAM_CEZANNE:
-	case FAM_REMBRANDT:
-	case FAM_MENDOCINO:
-	case FAM_PHOENIX:
-	case FAM_HAWKPOINT:
-	case FAM_KRACKANPOINT:
-	case FAM_STRIXPOINT:
-	case FAM_STRIXHALO:
-		_do_adjust(0x1d);
-	default:
-		break;
-	}
-	return err;
+	return atomic_load_acquire_u64(&ry->history->head_seq);
 }
 
-EXP int CALL set_psi0_current(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+EXP uint64_t CALL find_table_history_seq(ryzen_access ry, uint64_t timestamp_ns)
+{
+	if(!ry->history)
+		return 0;
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x24);
-		break;
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-	case FAM_CEZANNE:
-		_do_adjust(0x1e);
-	default:
-		break;
-	}
-	return err;
+	return table_history_find(ry->history, timestamp_ns);
 }
 
-EXP int CALL set_psi3cpu_current(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+EXP int CALL get_table_history_entry(ryzen_access ry, uint64_t seq, float *values, uint64_t *timestamp_ns)
+{
+	if(!ry->history)
+		return ADJ_ERR_NOT_AVAILABLE;
 
-	switch (ry->family)
-	{
-	case FAM_VANGOGH:
-		_do_adjust(0x20);
-	default:
-		break;
-	}
-	return err;
+	return table_history_read(ry->history, seq, values, timestamp_ns);
 }
 
-EXP int CALL set_psi0soc_current(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+EXP int CALL enable_table_stats(ryzen_access ry, const uint32_t *offsets, uint32_t offset_count)
+{
+	static const uint64_t window_ns[STATS_WINDOW_COUNT] = { 1000000000ull, 10000000000ull, 60000000000ull };
+	int errorcode;
+	uint32_t i;
+	_lazy_init_table(errorcode);
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x25);
-		break;
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-	case FAM_CEZANNE:
-		_do_adjust(0x1f);
-	default:
-		break;
+	for(i = 0; offsets && i < offset_count; i++){
+		if(offsets[i] % 4 || offsets[i] >= ry->table_size)
+			return ADJ_ERR_INVALID_ARG;
 	}
-	return err;
-}
 
-EXP int CALL set_psi3gfx_current(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+	table_stats_free(ry->stats);
+	ry->stats = table_stats_alloc(ry->table_size, offsets, offset_count, window_ns, STATS_WINDOW_COUNT);
+	if(!ry->stats)
+		return ADJ_ERR_OUT_OF_MEMORY;
 
-	switch (ry->family)
-	{
-	case FAM_VANGOGH:
-		_do_adjust(0x21);
-	default:
-		break;
-	}
-	return err;
+	return 0;
 }
 
-EXP int CALL set_max_gfxclk_freq(ryzen_access ry, uint32_t value) {
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
-
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-	case FAM_LUCIENNE:
-		_do_adjust(0x46);
-		break;
-	default:
-		break;
-	}
-	return err;
+EXP void CALL disable_table_stats(ryzen_access ry)
+{
+	table_stats_free(ry->stats);
+	ry->stats = NULL;
 }
 
-EXP int CALL set_min_gfxclk_freq(ryzen_access ry, uint32_t value) {
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+EXP int CALL get_table_stats(ryzen_access ry, uint32_t offset, enum ryzen_stats_window window, struct ryzen_field_stats *stats)
+{
+	if(!ry->stats)
+		return ADJ_ERR_NOT_AVAILABLE;
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-	case FAM_LUCIENNE:
-		_do_adjust(0x47);
-		break;
-	default:
-		break;
-	}
-	return err;
+	return table_stats_read(ry->stats, offset, window, get_monotonic_time_ns(), stats);
 }
 
-EXP int CALL set_max_socclk_freq(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
-
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x48);
-		break;
-	default:
-		break;
+#define _do_adjust(SMU, CLS, OPT) \
+do {                                                 \
+	smu_service_args_t args = {0, 0, 0, 0, 0, 0};    \
+	int resp;										 \
+	args.arg0 = value;                               \
+	resp = smu_service_req(SMU, CLS, OPT, &args);    \
+	if (resp == REP_MSG_OK) {                        \
+		err = 0;                                     \
+	} else if (resp == REP_MSG_UnknownCmd) {         \
+		err = ADJ_ERR_SMU_UNSUPPORTED;               \
+	} else {                                         \
+		err = ADJ_ERR_SMU_REJECTED;                  \
+	}                                                \
+} while (0);
+
+#define _read_float_value(OFFSET)                    \
+do {                                                 \
+	if(!ry->table_values)                            \
+		return NAN;                                  \
+	return ry->table_values[(OFFSET) / 4];           \
+} while (0);
+
+
+static void learn_unsupported(ryzen_access ry, enum ryzen_setting setting, uint32_t index)
+{
+	ry->ops[setting].unsupported |= 1u << index;
+	if (ry->capability_cache)
+		capability_cache_save(ry->capability_cache, ry->family, get_bios_if_ver(ry), ry->ops);
+}
+
+static int send_setting(ryzen_access ry, enum ryzen_setting setting, uint32_t value)
+{
+	const struct smu_op *op = &ry->ops[setting];
+	int err = ADJ_ERR_FAM_UNSUPPORTED;
+	uint32_t i, tried = 0;
+	smu_t smu;
+
+	value *= op->scale;
+	for (i = 0; i < op->count; i++) {
+		//don't repeat messages the firmware already answered with unknown command
+		if (op->unsupported & (1u << i)) {
+			err = ADJ_ERR_SMU_UNSUPPORTED;
+			continue;
+		}
+		if (tried++) {
+			ADJ_LOG(LOG_LEVEL_WARN, ADJ_ERR_SMU_UNSUPPORTED, "set_%s: Retry with %s", smu_op_name(setting), op->msgs[i].mailbox == TYPE_PSMU ? "PSMU" : "MP1");
+			note_retry(ry, setting, op->msgs[i].mailbox, tried, 0);
+		}
+		smu = get_mailbox(ry, op->msgs[i].mailbox);
+		if (!smu) {
+			err = ADJ_ERR_SMU_UNAVAILABLE;
+			continue;
+		}
+		_do_adjust(smu, op->cls, op->msgs[i].id);
+		if (!err)
+			break;
+		if (err == ADJ_ERR_SMU_UNSUPPORTED)
+			learn_unsupported(ry, setting, i);
 	}
+
 	return err;
 }
 
-EXP int CALL set_min_socclk_freq(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+static int apply_setting(ryzen_access ry, enum ryzen_setting setting, uint32_t value)
+{
+	_account_cpu_begin();
+	const int err = send_setting(ry, setting, value);
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x49);
-		break;
-	default:
-		break;
-	}
+	_account_cpu_end(ry);
 	return err;
 }
 
-EXP int CALL set_max_fclk_freq(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+//limits in effect as of the last refresh, NAN for settings without a table field or without a table
+static void get_current_limits(ryzen_access ry, const uint32_t *values, float *current)
+{
+	uint32_t setting;
+	int known = 1;
+
+	//the order only depends on current limits if both sides of a relation of values (NULL: none)
+	//are written, read the table just for that and only on families which have one
+	if (!ry->table_values && values && table_ver_msg(ry->family) && plan_has_pair(values))
+		known = !init_table_internal(ry);
+
+	for (setting = 0; setting < ADJ_SETTING_COUNT; setting++)
+		current[setting] = known ? get_setting_limit(ry, setting) : NAN;
+}
+
+EXP int CALL plan_settings(ryzen_access ry, const uint32_t *values, enum ryzen_setting *order, uint32_t *count)
+{
+	uint32_t planned[ADJ_SETTING_COUNT];
+	float current[ADJ_SETTING_COUNT];
+	uint32_t i;
+	int err;
+
+	get_current_limits(ry, values, current);
+	err = plan_order(values, current, planned, count);
+	for (i = 0; i < *count; i++)
+		order[i] = planned[i];
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x4A);
-		break;
-	default:
-		break;
-	}
 	return err;
 }
 
-EXP int CALL set_min_fclk_freq(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+EXP ryzen_profile CALL load_profile(ryzen_access ry, const char *path, const char *section, int *error)
+{
+	uint32_t values[ADJ_SETTING_COUNT], order[ADJ_SETTING_COUNT];
+	float unknown[ADJ_SETTING_COUNT];
+	struct profile_step *step;
+	ryzen_profile profile;
+	uint32_t setting, count = 0;
+	int err;
+
+	err = profile_parse(path, section, values);
+	for (setting = 0; setting < ADJ_SETTING_COUNT; setting++)
+		unknown[setting] = NAN;
+	//relations between settings of the profile itself, the ones to current limits are checked on apply
+	if (!err)
+		err = plan_order(values, unknown, order, &count);
+	count = 0;
+	for (setting = 0; !err && setting < ADJ_SETTING_COUNT; setting++) {
+		if (values[setting] == PROFILE_UNSET)
+			continue;
+		if (!ry->ops[setting].count) {
+			ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_FAM_UNSUPPORTED, "%s: %s is not supported on this family", path, smu_op_name(setting));
+			err = ADJ_ERR_FAM_UNSUPPORTED;
+		}
+		count++;
+	}
+	if (err)
+		goto fail;
+
+	profile = malloc(sizeof(*profile) + count * sizeof(profile->steps[0]));
+	if (!profile) {
+		err = ADJ_ERR_OUT_OF_MEMORY;
+		goto fail;
+	}
+
+	profile->family = ry->family;
+	profile->count = count;
+	step = profile->steps;
+	for (setting = 0; setting < ADJ_SETTING_COUNT; setting++) {
+		if (values[setting] == PROFILE_UNSET)
+			continue;
+		step->setting = setting;
+		step->value = values[setting];
+		step->arg = values[setting] * ry->ops[setting].scale;
+		step->cls = ry->ops[setting].cls;
+		step->count = ry->ops[setting].count;
+		memcpy(step->msgs, ry->ops[setting].msgs, sizeof(step->msgs));
+		step++;
+	}
+
+	if (error)
+		*error = 0;
+	return profile;
+
+fail:
+	if (error)
+		*error = err;
+	return NULL;
+}
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x4B);
-		break;
-	default:
-		break;
+//send_setting without name lookup and scaling
+static int send_profile_step(ryzen_access ry, const struct profile_step *step)
+{
+	const uint32_t value = step->arg;
+	int err = ADJ_ERR_FAM_UNSUPPORTED;
+	uint32_t k, tried = 0;
+	smu_t smu;
+
+	for (k = 0; k < step->count; k++) {
+		//learned by this handle, the profile itself may be shared between handles
+		if (ry->ops[step->setting].unsupported & (1u << k)) {
+			err = ADJ_ERR_SMU_UNSUPPORTED;
+			continue;
+		}
+		if (tried++)
+			note_retry(ry, step->setting, step->msgs[k].mailbox, tried, 0);
+		smu = get_mailbox(ry, step->msgs[k].mailbox);
+		if (!smu) {
+			err = ADJ_ERR_SMU_UNAVAILABLE;
+			continue;
+		}
+		_do_adjust(smu, step->cls, step->msgs[k].id);
+		if (!err)
+			break;
+		if (err == ADJ_ERR_SMU_UNSUPPORTED)
+			learn_unsupported(ry, step->setting, k);
 	}
+
 	return err;
 }
 
-EXP int CALL set_max_vcn(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+EXP int CALL apply_profile(ryzen_access ry, ryzen_profile profile)
+{
+	_account_cpu_begin();
+	uint32_t values[ADJ_SETTING_COUNT], order[ADJ_SETTING_COUNT], step_of[ADJ_SETTING_COUNT];
+	float current[ADJ_SETTING_COUNT];
+	const struct profile_step *step;
+	int err = 0, first_err = 0;
+	uint32_t i, count;
+
+	if (profile->family != ry->family) {
+		_account_cpu_end(ry);
+		return ADJ_ERR_FAM_UNSUPPORTED;
+	}
+
+	//order against the limits of the last refresh, nothing is sent if the result would break a relation
+	get_profile_values(profile, values);
+	for (i = 0; i < profile->count; i++)
+		step_of[profile->steps[i].setting] = i;
+	get_current_limits(ry, values, current);
+	err = plan_order(values, current, order, &count);
+	if (err) {
+		_account_cpu_end(ry);
+		return err;
+	}
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x4C);
-		break;
-	default:
-		break;
+	for (i = 0; i < count; i++) {
+		step = &profile->steps[step_of[order[i]]];
+		err = send_profile_step(ry, step);
+		if (err) {
+			ADJ_LOG(LOG_LEVEL_WARN, err, "profile: set_%s failed", smu_op_name(step->setting));
+			if (!first_err)
+				first_err = err;
+		}
 	}
-	return err;
+
+	_account_cpu_end(ry);
+	return first_err;
 }
 
-EXP int CALL set_min_vcn(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+EXP void CALL get_profile_values(ryzen_profile profile, uint32_t *values)
+{
+	uint32_t i;
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x4D);
-		break;
-	default:
-		break;
+	for (i = 0; i < ADJ_SETTING_COUNT; i++)
+		values[i] = PROFILE_UNSET;
+	for (i = 0; i < profile->count; i++)
+		values[profile->steps[i].setting] = profile->steps[i].value;
+}
+
+EXP void CALL free_profile(ryzen_profile profile)
+{
+	free(profile);
+}
+
+//pause between verification refreshes, the SMU refuses transfers in quick succession
+#define VERIFY_POLL_MS 20
+
+//one refresh checks all settings, repeated until they show up or the timeout passed
+static int verify_settings(ryzen_access ry, const uint32_t *values, const uint32_t *order, const uint32_t count,
+			   const uint32_t timeout_ms, int *failed)
+{
+	const uint64_t deadline = get_monotonic_time_ns() + (uint64_t)timeout_ms * 1000000;
+	uint32_t i;
+	float limit;
+	int err;
+
+	for (;;) {
+		err = refresh_table_internal(ry);
+		if (!err) {
+			for (i = 0; i < count; i++) {
+				limit = get_setting_limit(ry, order[i]);
+				if (!isnan(limit) && fabsf(limit - values[order[i]]) > ADJ_LIMIT_TOLERANCE)
+					break;
+			}
+			if (i == count)
+				return 0;
+			*failed = order[i];
+			err = ADJ_ERR_VERIFY_FAILED;
+		}
+		if (get_monotonic_time_ns() >= deadline)
+			return err;
+		Sleep(VERIFY_POLL_MS);
 	}
-	return err;
 }
 
-EXP int CALL set_max_lclk(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+//limits are never negative, this avoids lroundf and with it linking libm
+static uint32_t round_limit(const float limit)
+{
+	return (uint32_t)(limit + 0.5f);
+}
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x4E);
-		break;
-	default:
-		break;
+//send restore (UINT32_MAX: left alone) in an order valid on the way back, returns the first error
+static int send_restores(ryzen_access ry, const uint32_t *restore, const char *what)
+{
+	uint32_t restore_order[ADJ_SETTING_COUNT];
+	float current[ADJ_SETTING_COUNT];
+	uint32_t i, count;
+	int err, first_err = 0;
+
+	get_current_limits(ry, restore, current);
+	plan_order(restore, current, restore_order, &count);
+	for (i = 0; i < count; i++) {
+		err = send_setting(ry, restore_order[i], restore[restore_order[i]]);
+		if (err) {
+			ADJ_LOG(LOG_LEVEL_ERROR, err, "%s: set_%s failed", what, smu_op_name(restore_order[i]));
+			if (!first_err)
+				first_err = err;
+		}
 	}
-	return err;
+
+	return first_err;
 }
 
-EXP int CALL set_min_lclk(ryzen_access ry, uint32_t value){
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+//restore the first written settings of order to snapshot
+static void rollback_settings(ryzen_access ry, const float *snapshot, const uint32_t *order, const uint32_t written)
+{
+	uint32_t restore[ADJ_SETTING_COUNT];
+	uint32_t i;
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x4F);
-		break;
-	default:
-		break;
+	memset(restore, 0xFF, sizeof(restore));
+	for (i = 0; i < written; i++) {
+		if (isnan(snapshot[order[i]]))
+			ADJ_LOG(LOG_LEVEL_WARN, ADJ_ERR_NOT_AVAILABLE, "rollback: %s has no PM table field, left as is", smu_op_name(order[i]));
+		else
+			restore[order[i]] = round_limit(snapshot[order[i]]);
 	}
-	return err;
+
+	send_restores(ry, restore, "rollback");
 }
 
-EXP int CALL set_prochot_deassertion_ramp(ryzen_access ry, uint32_t value) {
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+static int run_transaction(ryzen_access ry, const uint32_t *values, ryzen_profile profile, const uint32_t verify_timeout_ms,
+			   int *failed_setting)
+{
+	uint32_t order[ADJ_SETTING_COUNT], step_of[ADJ_SETTING_COUNT];
+	float snapshot[ADJ_SETTING_COUNT];
+	uint32_t i, count;
+	int err, failed = -1;
 
-	/* \_SB.ALIB (0x0c, [size, 0x09, val]) */
+	//one refresh for the snapshot, which also gives the planner the current limits
+	err = refresh_table_internal(ry);
+	if (!err) {
+		get_current_limits(ry, values, snapshot);
+		err = plan_order(values, snapshot, order, &count);
+	}
+	if (err)
+		goto out;
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x26);
-		break;
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-	case FAM_CEZANNE:
-		_do_adjust(0x20);
-		break;
-	case FAM_VANGOGH:
-		_do_adjust(0x22);
-		break;
-	case FAM_REMBRANDT:
-	case FAM_MENDOCINO:
-	case FAM_PHOENIX:
-	case FAM_HAWKPOINT:
-	case FAM_KRACKANPOINT:
-	case FAM_STRIXPOINT:
-	case FAM_STRIXHALO:
-		_do_adjust(0x1f);
-	default:
-		break;
+	for (i = 0; profile && i < profile->count; i++)
+		step_of[profile->steps[i].setting] = i;
+
+	for (i = 0; i < count; i++) {
+		err = profile ? send_profile_step(ry, &profile->steps[step_of[order[i]]]) : send_setting(ry, order[i], values[order[i]]);
+		if (err) {
+			failed = order[i];
+			ADJ_LOG(LOG_LEVEL_ERROR, err, "transaction: set_%s failed, rolling back", smu_op_name(failed));
+			break;
+		}
 	}
+
+	if (!err) {
+		err = verify_settings(ry, values, order, count, verify_timeout_ms, &failed);
+		if (err)
+			ADJ_LOG(LOG_LEVEL_ERROR, err, "transaction: %s did not take effect, rolling back",
+				failed >= 0 ? smu_op_name(failed) : "table refresh");
+	}
+
+	//a setting refused by the SMU did not change, everything before it did
+	if (err)
+		rollback_settings(ry, snapshot, order, i);
+
+out:
+	if (failed_setting)
+		*failed_setting = failed;
 	return err;
 }
 
-EXP int CALL set_apu_skin_temp_limit(ryzen_access ry, uint32_t value) {
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+EXP int CALL apply_settings_transaction(ryzen_access ry, const uint32_t *values, uint32_t verify_timeout_ms, int *failed_setting)
+{
+	_account_cpu_begin();
+	const int err = run_transaction(ry, values, NULL, verify_timeout_ms, failed_setting);
 
-	/* \_SB.ALIB (0x0c, [size, 0x22, val]) */
+	_account_cpu_end(ry);
+	return err;
+}
 
-	value *= 256;
-	switch (ry->family)
-	{
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-	case FAM_CEZANNE:
-		_do_adjust(0x38);
-		break;
-	case FAM_VANGOGH:
-	case FAM_REMBRANDT:
-	case FAM_MENDOCINO:
-	case FAM_PHOENIX:
-	case FAM_HAWKPOINT:
-		_do_adjust(0x33);
-		break;
-	case FAM_STRIXHALO:
-		// not implemented on StrixHalo, seems to be controlled only via tctl-temp
-	default:
-		break;
+EXP int CALL apply_profile_transaction(ryzen_access ry, ryzen_profile profile, uint32_t verify_timeout_ms, int *failed_setting)
+{
+	_account_cpu_begin();
+	uint32_t values[ADJ_SETTING_COUNT];
+	int err = ADJ_ERR_FAM_UNSUPPORTED;
+
+	if (profile->family == ry->family) {
+		get_profile_values(profile, values);
+		err = run_transaction(ry, values, profile, verify_timeout_ms, failed_setting);
+	} else if (failed_setting) {
+		*failed_setting = -1;
 	}
+
+	_account_cpu_end(ry);
 	return err;
 }
 
-EXP int CALL set_dgpu_skin_temp_limit(ryzen_access ry, uint32_t value) {
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+struct _ryzen_session {
+	float snapshot[ADJ_SETTING_COUNT];  /* effective limits at begin_session, NAN: no table field */
+	uint8_t written[ADJ_SETTING_COUNT];
+};
 
-	/* \_SB.ALIB (0x0c, [size, 0x23, val]) */
+EXP ryzen_session CALL begin_session(ryzen_access ry, int *error)
+{
+	_account_cpu_begin();
+	ryzen_session session = NULL;
+	int err;
 
-	value *= 256;
-	switch (ry->family)
-	{
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-	case FAM_CEZANNE:
-		_do_adjust(0x39);
-		break;
-	case FAM_VANGOGH:
-	case FAM_REMBRANDT:
-	case FAM_MENDOCINO:
-	case FAM_PHOENIX:
-	case FAM_HAWKPOINT:
-	case FAM_STRIXPOINT:
-		_do_adjust(0x34);
-		break;
-	case FAM_STRIXHALO:
-		// not implemented on StrixHalo, seems to be controlled only via tctl-temp
-	default:
-		break;
+	err = refresh_table_internal(ry);
+	if (!err) {
+		session = calloc(1, sizeof(*session));
+		if (session)
+			get_current_limits(ry, NULL, session->snapshot);
+		else
+			err = ADJ_ERR_OUT_OF_MEMORY;
 	}
-	return err;
+
+	if (error)
+		*error = err;
+	_account_cpu_end(ry);
+	return session;
 }
 
-EXP int CALL set_apu_slow_limit(ryzen_access ry, uint32_t value) {
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+EXP int CALL session_apply_settings(ryzen_access ry, ryzen_session session, const uint32_t *values)
+{
+	_account_cpu_begin();
+	uint32_t order[ADJ_SETTING_COUNT];
+	float current[ADJ_SETTING_COUNT];
+	uint32_t i, count;
+	int err, first_err;
+
+	//plan against fresh limits, a value already in effect is neither sent nor restored later
+	first_err = refresh_table_internal(ry);
+	get_current_limits(ry, values, current);
+	err = plan_order(values, current, order, &count);
+	if (err) {
+		_account_cpu_end(ry);
+		return err;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!smu_op_is_switch(order[i]) && fabsf(current[order[i]] - values[order[i]]) <= ADJ_LIMIT_TOLERANCE)
+			continue;
+		//a rejected write may still have reached the firmware, restore it anyway
+		session->written[order[i]] = 1;
+		err = send_setting(ry, order[i], values[order[i]]);
+		if (err) {
+			ADJ_LOG(LOG_LEVEL_WARN, err, "session: set_%s failed", smu_op_name(order[i]));
+			if (!first_err)
+				first_err = err;
+		}
+	}
 
-	/* \_SB.ALIB (0x0c, [size, 0x13, val]) */
+	_account_cpu_end(ry);
+	return first_err;
+}
 
-	switch (ry->family)
-	{
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-	case FAM_CEZANNE:
-		_do_adjust(0x21);
-		break;
-	case FAM_REMBRANDT:
-	case FAM_PHOENIX:
-	case FAM_HAWKPOINT:
-	case FAM_KRACKANPOINT:
-	case FAM_STRIXPOINT:
-	case FAM_STRIXHALO:
-		_do_adjust(0x23);
-		break;
-	default:
-		break;
+EXP int CALL end_session(ryzen_access ry, ryzen_session session)
+{
+	_account_cpu_begin();
+	uint32_t restore[ADJ_SETTING_COUNT];
+	uint32_t setting;
+	float limit;
+	int err;
+
+	if (!session) {
+		_account_cpu_end(ry);
+		return 0;
+	}
+
+	//without a fresh table every written limit is restored
+	err = refresh_table_internal(ry);
+	memset(restore, 0xFF, sizeof(restore));
+	for (setting = 0; setting < ADJ_SETTING_COUNT; setting++) {
+		if (!session->written[setting])
+			continue;
+		if (smu_op_is_switch(setting)) {
+			ADJ_LOG(LOG_LEVEL_WARN, ADJ_ERR_NOT_AVAILABLE, "session: %s has no previous state to restore, left as is", smu_op_name(setting));
+			continue;
+		}
+		if (isnan(session->snapshot[setting])) {
+			ADJ_LOG(LOG_LEVEL_WARN, ADJ_ERR_NOT_AVAILABLE, "session: %s has no PM table field, left as is", smu_op_name(setting));
+			continue;
+		}
+		limit = get_setting_limit(ry, setting);
+		if (!err && fabsf(limit - session->snapshot[setting]) <= ADJ_LIMIT_TOLERANCE)
+			continue;
+		restore[setting] = round_limit(session->snapshot[setting]);
 	}
+
+	err = send_restores(ry, restore, "session");
+	free(session);
+
+	_account_cpu_end(ry);
 	return err;
 }
 
-EXP int CALL set_skin_temp_power_limit(ryzen_access ry, uint32_t value) {
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+struct async_setting {
+	struct smu_request req;          /* first, completions come back as smu_request */
+	enum ryzen_setting setting;
+	uint32_t index;                  /* message of ops[setting] in flight */
+	ryzen_setting_cb callback;
+	void *ctx;
+};
 
-    	/* \_SB.ALIB (0x0c, [size, 0x2e, val]) */
+//queue the first message from index on that is not known to be unsupported
+static int submit_async_setting(ryzen_access ry, struct async_setting *async, uint32_t index, uint32_t value)
+{
+	const struct smu_op *op = &ry->ops[async->setting];
+	int err = ADJ_ERR_FAM_UNSUPPORTED;
+	enum SMU_TYPE type;
+	smu_t smu;
 
-	switch (ry->family)
-	{
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-	case FAM_CEZANNE:
-		_do_adjust(0x53);
-		break;
-	case FAM_VANGOGH:
-	case FAM_REMBRANDT:
-	case FAM_MENDOCINO:
-	case FAM_PHOENIX:
-	case FAM_HAWKPOINT:
-	case FAM_KRACKANPOINT:
-	case FAM_STRIXPOINT:
-	case FAM_STRIXHALO:
-		_do_adjust(0x4a);
-		break;
-	default:
-		break;
+	if (!ry->wait_obj) {
+		ry->wait_obj = os_wait_obj_init();
+		if (!ry->wait_obj)
+			return ADJ_ERR_NOT_AVAILABLE;
+	}
+
+	for (; index < op->count; index++) {
+		if (op->unsupported & (1u << index)) {
+			err = ADJ_ERR_SMU_UNSUPPORTED;
+			continue;
+		}
+		type = op->msgs[index].mailbox;
+		smu = get_mailbox(ry, type);
+		if (!smu) {
+			err = ADJ_ERR_SMU_UNAVAILABLE;
+			continue;
+		}
+		if (!ry->queue[type]) {
+			ry->queue[type] = smu_queue_start(smu, ry->wait_obj);
+			if (!ry->queue[type])
+				return ADJ_ERR_OUT_OF_MEMORY;
+		}
+
+		async->index = index;
+		async->req.cls = op->cls;
+		async->req.id = op->msgs[index].id;
+		memset(&async->req.args, 0, sizeof(async->req.args));
+		async->req.args.arg0 = value;
+		smu_queue_submit(ry->queue[type], &async->req);
+		return 0;
 	}
+
 	return err;
 }
 
-EXP int CALL set_gfx_clk(ryzen_access ry, uint32_t value) {
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
-
-	switch (ry->family)
-	{
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-	case FAM_CEZANNE:
-	case FAM_VANGOGH:
-	case FAM_REMBRANDT:
-	case FAM_MENDOCINO:
-	case FAM_PHOENIX:
-	case FAM_HAWKPOINT:
-	case FAM_KRACKANPOINT: /* Added to debug on KRK, STX, & STXH */
-	case FAM_STRIXPOINT:
-	case FAM_STRIXHALO:
-		_do_adjust_psmu(0x89);
-		break;
-	default:
-		break;
+static int complete_async_settings(ryzen_access ry)
+{
+	struct smu_request *req, *next;
+	struct async_setting *async;
+	int i, err, handled = 0;
+
+	for (i = 0; i < TYPE_COUNT; i++) {
+		if (!ry->queue[i])
+			continue;
+
+		for (req = smu_queue_take_done(ry->queue[i]); req; req = next) {
+			next = req->next;
+			async = (struct async_setting *)req;
+
+			if (req->response == REP_MSG_OK) {
+				err = 0;
+			} else if (req->response == REP_MSG_UnknownCmd) {
+				learn_unsupported(ry, async->setting, async->index);
+				//same value as sent, already scaled
+				err = submit_async_setting(ry, async, async->index + 1, async->req.args.arg0);
+				if (!err) {
+					ADJ_LOG(LOG_LEVEL_WARN, ADJ_ERR_SMU_UNSUPPORTED, "set_%s: Retry with %s", smu_op_name(async->setting),
+						ry->ops[async->setting].msgs[async->index].mailbox == TYPE_PSMU ? "PSMU" : "MP1");
+					note_retry(ry, async->setting, ry->ops[async->setting].msgs[async->index].mailbox,
+						    async->index + 1, 0);
+					continue;
+				}
+				if (err == ADJ_ERR_FAM_UNSUPPORTED)
+					err = ADJ_ERR_SMU_UNSUPPORTED;
+			} else {
+				err = ADJ_ERR_SMU_REJECTED;
+			}
+
+			if (async->callback)
+				async->callback(ry, async->setting, err, async->ctx);
+			free(async);
+			handled++;
+		}
 	}
-	return err;
+
+	return handled;
 }
 
-EXP int CALL set_power_saving(ryzen_access ry) {
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
-	uint32_t value = 0;
+EXP int CALL set_setting_async(ryzen_access ry, enum ryzen_setting setting, uint32_t value,
+			       ryzen_setting_cb callback, void *ctx)
+{
+	struct async_setting *async;
+	int err;
 
-	/* \_SB.ALIB (0x01, [size, 0x1]) */
+	if (setting < 0 || setting >= ADJ_SETTING_COUNT)
+		return ADJ_ERR_INVALID_ARG;
+	if (!ry->ops[setting].count)
+		return ADJ_ERR_FAM_UNSUPPORTED;
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x19);
-		break;
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-	case FAM_CEZANNE:
-	case FAM_VANGOGH:
-	case FAM_REMBRANDT:
-	case FAM_MENDOCINO:
-	case FAM_PHOENIX:
-	case FAM_HAWKPOINT:
-	case FAM_KRACKANPOINT:
-	case FAM_STRIXPOINT:
-	case FAM_STRIXHALO:
-		_do_adjust(0x12);
-		break;
-	default:
-		break;
-	}
+	async = calloc(1, sizeof(*async));
+	if (!async)
+		return ADJ_ERR_OUT_OF_MEMORY;
+	async->setting = setting;
+	async->callback = callback;
+	async->ctx = ctx;
+
+	_account_cpu_begin();
+	err = submit_async_setting(ry, async, 0, value * ry->ops[setting].scale);
+	_account_cpu_end(ry);
+	if (err)
+		free(async);
 	return err;
 }
 
-EXP int CALL set_max_performance(ryzen_access ry) {
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
-	uint32_t value = 0;
+EXP int CALL get_smu_queue_stats(ryzen_access ry, enum ryzen_mailbox mailbox, struct ryzen_queue_stats *stats)
+{
+	if (mailbox < 0 || mailbox >= ADJ_MAILBOX_COUNT)
+		return ADJ_ERR_INVALID_ARG;
 
-	/* \_SB.ALIB (0x01, [size, 0x0]) */
+	memset(stats, 0, sizeof(*stats));
+	//no queue before the first async request on this mailbox
+	if (ry->queue[mailbox])
+		smu_queue_read_stats(ry->queue[mailbox], stats);
+	return 0;
+}
 
-	switch (ry->family)
-	{
-	case FAM_RAVEN:
-	case FAM_PICASSO:
-	case FAM_DALI:
-		_do_adjust(0x18);
-		break;
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-	case FAM_CEZANNE:
-	case FAM_VANGOGH:
-	case FAM_REMBRANDT:
-	case FAM_MENDOCINO:
-	case FAM_PHOENIX:
-	case FAM_HAWKPOINT:
-	case FAM_KRACKANPOINT:
-	case FAM_STRIXPOINT:
-	case FAM_STRIXHALO:
-		_do_adjust(0x11);
-		break;
-	default:
-		break;
-	}
-	return err;
+EXP int CALL set_setting_class(ryzen_access ry, enum ryzen_setting setting, enum ryzen_smu_class cls)
+{
+	if (setting < 0 || setting >= ADJ_SETTING_COUNT || cls < 0 || cls >= ADJ_CLASS_COUNT)
+		return ADJ_ERR_INVALID_ARG;
+
+	ry->ops[setting].cls = (enum SMU_CLASS)cls;
+	return 0;
 }
 
-EXP int CALL set_oc_clk(ryzen_access ry, uint32_t value) {
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+EXP int CALL set_smu_class_rate_limit(ryzen_access ry, enum ryzen_smu_class cls, uint32_t min_interval_us)
+{
+	if (cls < 0 || cls >= ADJ_CLASS_COUNT)
+		return ADJ_ERR_INVALID_ARG;
 
-	switch (ry->family)
-	{
-	case FAM_LUCIENNE:
-	case FAM_RENOIR:
-	case FAM_CEZANNE:
-	case FAM_REMBRANDT:
-		_do_adjust(0x31);
-        if (err) {
-            printf("%s: Retry with PSMU\n", __func__);
-		    _do_adjust_psmu(0x19);
-        }
-		break;
-	default:
-		break;
-	}
-	return err;
+	ry->smu_ctx.min_interval_ns[cls] = (uint64_t)min_interval_us * 1000;
+	return 0;
 }
 
-EXP int CALL set_per_core_oc_clk(ryzen_access ry, uint32_t value) {
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+EXP int CALL set_smu_starvation_limit(ryzen_access ry, uint32_t max_wait_us)
+{
+	ry->smu_ctx.starvation_ns = (uint64_t)max_wait_us * 1000;
+	return 0;
+}
 
-	switch (ry->family)
-	{
-	case FAM_LUCIENNE:
-	case FAM_RENOIR:
-	case FAM_CEZANNE:
-	case FAM_REMBRANDT:
-		_do_adjust(0x32);
-        if (err) {
-            printf("%s: Retry with PSMU\n", __func__);
-		    _do_adjust_psmu(0x1a);
-        }
-		break;
-	default:
-		break;
-	}
-	return err;
+EXP void CALL get_self_stats(ryzen_access ry, struct ryzen_self_stats *stats)
+{
+	const struct smu_counters *counters = &ry->smu_ctx.counters;
+	int i;
+
+	for (i = 0; i < ADJ_MAILBOX_COUNT; i++)
+		stats->smu_messages[i] = atomic_load_acquire_u64(&counters->smu_messages[i]);
+	stats->smn_reads = atomic_load_acquire_u64(&counters->smn_reads);
+	stats->smn_writes = atomic_load_acquire_u64(&counters->smn_writes);
+	stats->syscalls = atomic_load_acquire_u64(&counters->syscalls);
+	stats->bytes_copied = atomic_load_acquire_u64(&counters->bytes_copied);
+	stats->refreshes = atomic_load_acquire_u64(&counters->refreshes);
+	stats->retries = atomic_load_acquire_u64(&counters->retries);
+	stats->cpu_time_ns = atomic_load_acquire_u64(&counters->cpu_ns);
 }
 
-EXP int CALL set_oc_volt(ryzen_access ry, uint32_t value) {
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+EXP void CALL reset_self_stats(ryzen_access ry)
+{
+	//counters may be bumped concurrently, a reset racing with that may lose a few counts
+	memset((void *)&ry->smu_ctx.counters, 0, sizeof(ry->smu_ctx.counters));
+}
 
-	switch (ry->family)
-	{
-	case FAM_LUCIENNE:
-	case FAM_RENOIR:
-	case FAM_CEZANNE:
-		_do_adjust(0x33);
-        if (err) {
-            printf("%s: Retry with PSMU\n", __func__);
-		    _do_adjust_psmu(0x1b);
-        }
-		break;
-	default:
-		break;
-	}
-	return err;
+EXP int CALL is_setting_supported(ryzen_access ry, enum ryzen_setting setting)
+{
+	const struct smu_op *op;
+
+	if (setting < 0 || setting >= ADJ_SETTING_COUNT)
+		return 0;
+
+	op = &ry->ops[setting];
+	return op->count && op->unsupported != (1u << op->count) - 1;
 }
 
-EXP int CALL set_disable_oc(ryzen_access ry) {
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
-	uint32_t value = 0x0;
+EXP int CALL enable_capability_cache(ryzen_access ry, const char *path)
+{
+	char default_path[CACHE_PATH_MAX];
+	int errorcode;
 
-	switch (ry->family)
-	{
-	case FAM_LUCIENNE:
-	case FAM_RENOIR:
-	case FAM_CEZANNE:
-		_do_adjust(0x30);
-        if (err) {
-            printf("%s: Retry with PSMU\n", __func__);
-		    _do_adjust_psmu(0x1d);
-        }
-		break;
-	case FAM_REMBRANDT:
-		_do_adjust_psmu(0x18);
-		break;
-	default:
-		break;
+	if (!path) {
+		errorcode = cache_file_path("capabilities", default_path, sizeof(default_path));
+		if (errorcode)
+			return errorcode;
+		path = default_path;
 	}
-	return err;
+
+	free(ry->capability_cache);
+	ry->capability_cache = strdup(path);
+	if (!ry->capability_cache)
+		return ADJ_ERR_OUT_OF_MEMORY;
+
+	//a missing or outdated file is fine, it gets written on the first learned message
+	capability_cache_load(ry->capability_cache, ry->family, get_bios_if_ver(ry), ry->ops);
+	return 0;
 }
 
-EXP int CALL set_enable_oc(ryzen_access ry) {
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
-	uint32_t value = 0x0;
+EXP int CALL set_setting(ryzen_access ry, enum ryzen_setting setting, uint32_t value)
+{
+	if (setting < 0 || setting >= ADJ_SETTING_COUNT)
+		return ADJ_ERR_INVALID_ARG;
 
-	switch (ry->family)
-	{
-	case FAM_LUCIENNE:
-	case FAM_RENOIR:
-	case FAM_CEZANNE:
-		_do_adjust(0x2F);
-		break;
-	case FAM_REMBRANDT:
-		_do_adjust_psmu(0x17);
-		break;
-	default:
-		break;
-	}
-	return err;
+	return apply_setting(ry, setting, value);
 }
 
-EXP int CALL set_coall(ryzen_access ry, uint32_t value) {
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+EXP const char* CALL get_setting_name(enum ryzen_setting setting)
+{
+	return smu_op_name(setting);
+}
 
-	switch (ry->family)
-	{
-	case FAM_CEZANNE:
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-		_do_adjust(0x55);
-		break;
-	case FAM_REMBRANDT:
-	case FAM_VANGOGH:
-	case FAM_PHOENIX:
-	case FAM_HAWKPOINT:
-	case FAM_KRACKANPOINT:
-	case FAM_STRIXPOINT:
-	case FAM_STRIXHALO:
-		_do_adjust(0x4C);
-		break;
-	case FAM_DRAGONRANGE:
-	case FAM_FIRERANGE:
-		_do_adjust_psmu(0x7);
-		break;
-	default:
-		break;
-	}
-	return err;
+EXP int CALL is_setting_switch(enum ryzen_setting setting)
+{
+	return smu_op_is_switch(setting);
 }
 
-EXP int CALL set_coper(ryzen_access ry, uint32_t value) {
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+EXP int CALL find_setting_by_name(const char *key)
+{
+	char name[64];
+	size_t i;
+	int setting;
 
-	switch (ry->family)
-	{
-	case FAM_CEZANNE:
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-		_do_adjust(0x54);
-		break;
-	case FAM_REMBRANDT:
-	case FAM_PHOENIX:
-	case FAM_VANGOGH:
-	case FAM_HAWKPOINT:
-	case FAM_KRACKANPOINT:
-	case FAM_STRIXPOINT:
-	case FAM_STRIXHALO:
-		_do_adjust(0x4b);
-		break;
-	case FAM_DRAGONRANGE:
-	case FAM_FIRERANGE:
-		_do_adjust_psmu(0x6);
-		break;
-	default:
-		break;
+	//CLI spelling "fast-limit" and library spelling "fast_limit"
+	for (i = 0; key[i] && i < sizeof(name) - 1; i++)
+		name[i] = key[i] == '-' ? '_' : tolower((unsigned char)key[i]);
+	name[i] = '\0';
+
+	for (setting = 0; setting < ADJ_SETTING_COUNT; setting++) {
+		if (!strcmp(name, smu_op_name(setting)))
+			return setting;
 	}
-	return err;
-}
 
-EXP int CALL set_cogfx(ryzen_access ry, uint32_t value) {
-    int err = ADJ_ERR_FAM_UNSUPPORTED;
+	return -1;
+}
 
-	switch (ry->family)
-	{
-	case FAM_CEZANNE:
-	case FAM_RENOIR:
-	case FAM_LUCIENNE:
-		_do_adjust(0x64);
-		break;
-	case FAM_REMBRANDT:
-	case FAM_PHOENIX:
-	case FAM_HAWKPOINT:
-	case FAM_VANGOGH:
-		_do_adjust_psmu(0xB7);
-		break;
-	case FAM_STRIXHALO:
-		// 0xB7 is rejected on this architecture
+//PM table limit of a setting, converted from W, A, s and degree C to the units of set_setting
+EXP float CALL get_setting_limit(ryzen_access ry, enum ryzen_setting setting)
+{
+	switch (setting) {
+	case ADJ_STAPM_LIMIT: return get_stapm_limit(ry) * 1000;
+	case ADJ_FAST_LIMIT: return get_fast_limit(ry) * 1000;
+	case ADJ_SLOW_LIMIT: return get_slow_limit(ry) * 1000;
+	case ADJ_APU_SLOW_LIMIT: return get_apu_slow_limit(ry) * 1000;
+	case ADJ_STAPM_TIME: return get_stapm_time(ry);
+	case ADJ_SLOW_TIME: return get_slow_time(ry);
+	case ADJ_TCTL_TEMP: return get_tctl_temp(ry);
+	case ADJ_APU_SKIN_TEMP_LIMIT: return get_apu_skin_temp_limit(ry);
+	case ADJ_DGPU_SKIN_TEMP_LIMIT: return get_dgpu_skin_temp_limit(ry);
+	case ADJ_VRM_CURRENT: return get_vrm_current(ry) * 1000;
+	case ADJ_VRMSOC_CURRENT: return get_vrmsoc_current(ry) * 1000;
+	case ADJ_VRMMAX_CURRENT: return get_vrmmax_current(ry) * 1000;
+	case ADJ_VRMSOCMAX_CURRENT: return get_vrmsocmax_current(ry) * 1000;
+	case ADJ_PSI0_CURRENT: return get_psi0_current(ry) * 1000;
+	case ADJ_PSI0SOC_CURRENT: return get_psi0soc_current(ry) * 1000;
 	default:
 		break;
 	}
-	return err;
+	return NAN;
+}
+
+EXP int CALL set_stapm_limit(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_STAPM_LIMIT, value);
+}
+
+EXP int CALL set_fast_limit(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_FAST_LIMIT, value);
+}
+
+EXP int CALL set_slow_limit(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_SLOW_LIMIT, value);
+}
+
+EXP int CALL set_slow_time(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_SLOW_TIME, value);
+}
+
+EXP int CALL set_stapm_time(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_STAPM_TIME, value);
+}
+
+EXP int CALL set_tctl_temp(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_TCTL_TEMP, value);
+}
+
+EXP int CALL set_vrm_current(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_VRM_CURRENT, value);
+}
+
+EXP int CALL set_vrmsoc_current(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_VRMSOC_CURRENT, value);
+}
+
+EXP int CALL set_vrmgfx_current(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_VRMGFX_CURRENT, value);
+}
+
+EXP int CALL set_vrmcvip_current(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_VRMCVIP_CURRENT, value);
+}
+
+EXP int CALL set_vrmmax_current(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_VRMMAX_CURRENT, value);
+}
+
+EXP int CALL set_vrmgfxmax_current(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_VRMGFXMAX_CURRENT, value);
+}
+
+EXP int CALL set_vrmsocmax_current(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_VRMSOCMAX_CURRENT, value);
+}
+
+EXP int CALL set_psi0_current(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_PSI0_CURRENT, value);
+}
+
+EXP int CALL set_psi3cpu_current(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_PSI3CPU_CURRENT, value);
+}
+
+EXP int CALL set_psi0soc_current(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_PSI0SOC_CURRENT, value);
+}
+
+EXP int CALL set_psi3gfx_current(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_PSI3GFX_CURRENT, value);
+}
+
+EXP int CALL set_max_gfxclk_freq(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_MAX_GFXCLK_FREQ, value);
+}
+
+EXP int CALL set_min_gfxclk_freq(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_MIN_GFXCLK_FREQ, value);
+}
+
+EXP int CALL set_max_socclk_freq(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_MAX_SOCCLK_FREQ, value);
+}
+
+EXP int CALL set_min_socclk_freq(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_MIN_SOCCLK_FREQ, value);
+}
+
+EXP int CALL set_max_fclk_freq(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_MAX_FCLK_FREQ, value);
+}
+
+EXP int CALL set_min_fclk_freq(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_MIN_FCLK_FREQ, value);
+}
+
+EXP int CALL set_max_vcn(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_MAX_VCN, value);
+}
+
+EXP int CALL set_min_vcn(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_MIN_VCN, value);
+}
+
+EXP int CALL set_max_lclk(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_MAX_LCLK, value);
+}
+
+EXP int CALL set_min_lclk(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_MIN_LCLK, value);
+}
+
+EXP int CALL set_prochot_deassertion_ramp(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_PROCHOT_DEASSERTION_RAMP, value);
+}
+
+EXP int CALL set_apu_skin_temp_limit(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_APU_SKIN_TEMP_LIMIT, value);
+}
+
+EXP int CALL set_dgpu_skin_temp_limit(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_DGPU_SKIN_TEMP_LIMIT, value);
+}
+
+EXP int CALL set_apu_slow_limit(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_APU_SLOW_LIMIT, value);
+}
+
+EXP int CALL set_skin_temp_power_limit(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_SKIN_TEMP_POWER_LIMIT, value);
+}
+
+EXP int CALL set_gfx_clk(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_GFX_CLK, value);
+}
+
+EXP int CALL set_power_saving(ryzen_access ry) {
+	return apply_setting(ry, ADJ_POWER_SAVING, 0);
+}
+
+EXP int CALL set_max_performance(ryzen_access ry) {
+	return apply_setting(ry, ADJ_MAX_PERFORMANCE, 0);
+}
+
+EXP int CALL set_oc_clk(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_OC_CLK, value);
+}
+
+EXP int CALL set_per_core_oc_clk(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_PER_CORE_OC_CLK, value);
+}
+
+EXP int CALL set_oc_volt(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_OC_VOLT, value);
+}
+
+EXP int CALL set_disable_oc(ryzen_access ry) {
+	return apply_setting(ry, ADJ_DISABLE_OC, 0);
+}
+
+EXP int CALL set_enable_oc(ryzen_access ry) {
+	return apply_setting(ry, ADJ_ENABLE_OC, 0);
+}
+
+EXP int CALL set_coall(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_COALL, value);
+}
+
+EXP int CALL set_coper(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_COPER, value);
+}
+
+EXP int CALL set_cogfx(ryzen_access ry, uint32_t value) {
+	return apply_setting(ry, ADJ_COGFX, value);
 }
 
 //PM Table section, offset of first lines are stable across multiple PM Table versions
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj minimal atomic helpers, MSVC does not ship usable C11 atomics */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+
+/* x64 is strongly ordered, a compiler barrier is enough for acquire/release */
+static __inline uint64_t atomic_load_acquire_u64(volatile uint64_t *p)
+{
+	uint64_t v = *p;
+	_ReadWriteBarrier();
+	return v;
+}
+
+static __inline void atomic_store_release_u64(volatile uint64_t *p, uint64_t v)
+{
+	_ReadWriteBarrier();
+	*p = v;
+}
+
+static __inline uint64_t atomic_fetch_add_u64(volatile uint64_t *p, uint64_t v)
+{
+	return (uint64_t)_InterlockedExchangeAdd64((volatile __int64 *)p, (__int64)v);
+}
+
+#define atomic_fence_acquire() _ReadWriteBarrier()
+#define atomic_fence_release() _ReadWriteBarrier()
+
+#else
+
+#define atomic_load_acquire_u64(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define atomic_store_release_u64(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define atomic_fetch_add_u64(p, v) __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#define atomic_fence_acquire() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define atomic_fence_release() __atomic_thread_fence(__ATOMIC_RELEASE)
+
+#endif
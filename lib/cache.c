@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj on-disk caches */
+#include <stdlib.h>
+#include <string.h>
+
+#include "ryzenadj.h"
+#include "cache.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define CAPABILITY_CACHE_MAGIC "ryzenadj-capabilities"
+#define CAPABILITY_CACHE_VERSION 1
+#define INIT_CACHE_MAGIC "ryzenadj-init"
+#define INIT_CACHE_VERSION 1
+
+int cache_file_path(const char *name, char *path, size_t size)
+{
+	const char *dir = getenv("RYZENADJ_CACHE_DIR");
+	int len;
+
+	if (!dir || !*dir) {
+#ifdef _WIN32
+		const char *base = getenv("ProgramData");
+		static char win_dir[CACHE_PATH_MAX];
+
+		if (!base)
+			return ADJ_ERR_NOT_AVAILABLE;
+		snprintf(win_dir, sizeof(win_dir), "%s\\RyzenAdj", base);
+		dir = win_dir;
+#else
+		dir = "/var/cache/ryzenadj";
+#endif
+		//only the default directory is ours to create
+		mkdir(dir, 0755);
+	}
+
+#ifdef _WIN32
+	len = snprintf(path, size, "%s\\%s", dir, name);
+#else
+	len = snprintf(path, size, "%s/%s", dir, name);
+#endif
+	if (len < 0 || (size_t)len >= size)
+		return ADJ_ERR_INVALID_ARG;
+
+	return 0;
+}
+
+//cached values are used without asking the SMU, only trust files nobody but root could have written
+static int cache_file_trusted(FILE *f)
+{
+#ifndef _WIN32
+	struct stat st;
+
+	if (fstat(fileno(f), &st) || st.st_uid != 0 || (st.st_mode & (S_IWGRP | S_IWOTH))) {
+		DBG("ignoring cache file not owned by root or writable by others\n");
+		return 0;
+	}
+#endif
+	return 1;
+}
+
+/*
+ * Text format, one learned setting per line:
+ *   ryzenadj-capabilities 1
+ *   family <family> bios_if_ver <version>
+ *   <setting name> <bitmask of messages answered with unknown command>
+ */
+int capability_cache_load(const char *path, const int family, const int bios_if_ver, struct smu_op *ops)
+{
+	char magic[32], name[64];
+	int version, file_family, file_bios_if_ver;
+	uint32_t setting, mask;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f)
+		return ADJ_ERR_NOT_AVAILABLE;
+	if (!cache_file_trusted(f)) {
+		fclose(f);
+		return ADJ_ERR_NOT_AVAILABLE;
+	}
+
+	if (fscanf(f, "%31s %d family %d bios_if_ver %d", magic, &version, &file_family, &file_bios_if_ver) != 4 ||
+	    strcmp(magic, CAPABILITY_CACHE_MAGIC) || version != CAPABILITY_CACHE_VERSION ||
+	    file_family != family || file_bios_if_ver != bios_if_ver) {
+		fclose(f);
+		return ADJ_ERR_NOT_AVAILABLE;
+	}
+
+	while (fscanf(f, "%63s %u", name, &mask) == 2) {
+		for (setting = 0; setting < ADJ_SETTING_COUNT; setting++) {
+			if (!strcmp(name, smu_op_name(setting))) {
+				ops[setting].unsupported |= mask & ((1u << ops[setting].count) - 1);
+				break;
+			}
+		}
+	}
+
+	fclose(f);
+	return 0;
+}
+
+static int replace_file(const char *tmp_path, const char *path)
+{
+#ifdef _WIN32
+	remove(path);
+#else
+	//independent of the umask, loading refuses files writable by others
+	chmod(tmp_path, 0644);
+#endif
+	if (rename(tmp_path, path)) {
+		remove(tmp_path);
+		return ADJ_ERR_MEMORY_ACCESS;
+	}
+
+	return 0;
+}
+
+int capability_cache_save(const char *path, const int family, const int bios_if_ver, const struct smu_op *ops)
+{
+	char tmp_path[CACHE_PATH_MAX + 8];
+	uint32_t setting;
+	FILE *f;
+
+	//write a private copy and rename it, concurrent readers never see a partial file
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+	f = fopen(tmp_path, "w");
+	if (!f)
+		return ADJ_ERR_MEMORY_ACCESS;
+
+	fprintf(f, "%s %d\nfamily %d bios_if_ver %d\n", CAPABILITY_CACHE_MAGIC, CAPABILITY_CACHE_VERSION,
+		family, bios_if_ver);
+	for (setting = 0; setting < ADJ_SETTING_COUNT; setting++) {
+		if (ops[setting].unsupported)
+			fprintf(f, "%s %u\n", smu_op_name(setting), ops[setting].unsupported);
+	}
+
+	if (fclose(f)) {
+		remove(tmp_path);
+		return ADJ_ERR_MEMORY_ACCESS;
+	}
+
+	return replace_file(tmp_path, path);
+}
+
+int init_cache_load(const char *path, struct init_cache *entry)
+{
+	unsigned long long table_size, table_addr;
+	char magic[32];
+	int version, ok;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f)
+		return ADJ_ERR_NOT_AVAILABLE;
+	if (!cache_file_trusted(f)) {
+		fclose(f);
+		return ADJ_ERR_NOT_AVAILABLE;
+	}
+
+	memset(entry, 0, sizeof(*entry));
+	ok = fscanf(f, "%31s %d boot_id %63s cpuid %x smu_driver %d family %d bios_if_ver %d",
+		    magic, &version, entry->boot_id, &entry->cpuid, &entry->smu_driver, &entry->family,
+		    &entry->bios_if_ver) == 7 &&
+	     fscanf(f, " mp1 %x %x %x psmu %x %x %x", &entry->mailbox[0][0], &entry->mailbox[0][1],
+		    &entry->mailbox[0][2], &entry->mailbox[1][0], &entry->mailbox[1][1], &entry->mailbox[1][2]) == 6 &&
+	     fscanf(f, " table %x %llx %llx", &entry->table_ver, &table_size, &table_addr) == 3 &&
+	     !strcmp(magic, INIT_CACHE_MAGIC) && version == INIT_CACHE_VERSION;
+	fclose(f);
+
+	if (!ok)
+		return ADJ_ERR_NOT_AVAILABLE;
+
+	entry->table_size = table_size;
+	entry->table_addr = table_addr;
+	return 0;
+}
+
+int init_cache_save(const char *path, const struct init_cache *entry)
+{
+	char tmp_path[CACHE_PATH_MAX + 8];
+	FILE *f;
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+	f = fopen(tmp_path, "w");
+	if (!f)
+		return ADJ_ERR_MEMORY_ACCESS;
+
+	fprintf(f, "%s %d\nboot_id %s\ncpuid %x\nsmu_driver %d\nfamily %d\nbios_if_ver %d\n",
+		INIT_CACHE_MAGIC, INIT_CACHE_VERSION, entry->boot_id, entry->cpuid, entry->smu_driver,
+		entry->family, entry->bios_if_ver);
+	fprintf(f, "mp1 %x %x %x\npsmu %x %x %x\n", entry->mailbox[0][0], entry->mailbox[0][1],
+		entry->mailbox[0][2], entry->mailbox[1][0], entry->mailbox[1][1], entry->mailbox[1][2]);
+	fprintf(f, "table %x %llx %llx\n", entry->table_ver, (unsigned long long)entry->table_size,
+		(unsigned long long)entry->table_addr);
+
+	if (fclose(f)) {
+		remove(tmp_path);
+		return ADJ_ERR_MEMORY_ACCESS;
+	}
+
+	return replace_file(tmp_path, path);
+}
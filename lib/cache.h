@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj on-disk caches */
+/* Do not include this file! */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CACHE_PATH_MAX 512
+
+struct smu_op;
+
+/* everything init_ryzenadj and init_table learn from SMU round trips, valid for one boot */
+struct init_cache {
+	char boot_id[64];
+	uint32_t cpuid;                  /* raw signature, exact CPU model */
+	int smu_driver;                  /* ryzen_smu kernel module or /dev/mem backend */
+	int family;
+	int bios_if_ver;
+	uint32_t mailbox[2][3];          /* MP1 and PSMU: message, response, argument base */
+	uint32_t table_ver;
+	uint64_t table_size;
+	uint64_t table_addr;             /* 0 if init_table was not run yet */
+};
+
+/* $RYZENADJ_CACHE_DIR/name, or the system cache directory which gets created on demand */
+int cache_file_path(const char *name, char *path, size_t size);
+
+int capability_cache_load(const char *path, int family, int bios_if_ver, struct smu_op *ops);
+int capability_cache_save(const char *path, int family, int bios_if_ver, const struct smu_op *ops);
+
+int init_cache_load(const char *path, struct init_cache *entry);
+int init_cache_save(const char *path, const struct init_cache *entry);
@@ -0,0 +1,286 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj client of ryzenadjd */
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "ryzenadj_client.h"
+#include "smu_ops.h"
+
+#define DEFAULT_SOCKET "/run/ryzenadjd.sock"
+#define READ_CHUNK 4096
+
+struct _ryzenadj_client {
+	int fd;
+	char *buf;                       /* received and not yet consumed */
+	size_t len;
+	size_t cap;
+	size_t answered;                 /* bytes of the last answer, dropped by the next request */
+	float *table;
+	size_t table_count;
+	int table_pending;               /* a pushed table waits for client_dispatch */
+	client_refresh_cb callback;
+	void *ctx;
+};
+
+EXP ryzenadj_client CALL init_ryzenadj_client(const char *path)
+{
+	struct sockaddr_un addr;
+	ryzenadj_client client;
+
+	if (!path)
+		path = getenv("RYZENADJD_SOCKET");
+	if (!path)
+		path = DEFAULT_SOCKET;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return NULL;
+	strcpy(addr.sun_path, path);
+
+	client = calloc(1, sizeof(*client));
+	if (!client)
+		return NULL;
+
+	client->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (client->fd < 0 || connect(client->fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		cleanup_ryzenadj_client(client);
+		return NULL;
+	}
+
+	return client;
+}
+
+EXP void CALL cleanup_ryzenadj_client(ryzenadj_client client)
+{
+	if (!client)
+		return;
+	if (client->fd >= 0)
+		close(client->fd);
+	free(client->buf);
+	free(client->table);
+	free(client);
+}
+
+static void consume(ryzenadj_client client, const size_t bytes)
+{
+	memmove(client->buf, client->buf + bytes, client->len - bytes);
+	client->len -= bytes;
+}
+
+//read what is there, blocking for at least one byte unless nonblock
+static int receive(ryzenadj_client client, const int nonblock)
+{
+	ssize_t n;
+	char *buf;
+
+	if (client->cap - client->len < READ_CHUNK) {
+		buf = realloc(client->buf, client->cap + READ_CHUNK);
+		if (!buf)
+			return ADJ_ERR_OUT_OF_MEMORY;
+		client->buf = buf;
+		client->cap += READ_CHUNK;
+	}
+
+	do {
+		n = recv(client->fd, client->buf + client->len, client->cap - client->len, nonblock ? MSG_DONTWAIT : 0);
+	} while (n < 0 && errno == EINTR);
+
+	if (n > 0) {
+		client->len += n;
+		return 0;
+	}
+	if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		return ADJ_ERR_WOULD_BLOCK;
+	return ADJ_ERR_SMU_UNAVAILABLE;
+}
+
+//"<count> <value>..." into the client table
+static int store_table(ryzenadj_client client, const char *p)
+{
+	unsigned long count;
+	float *table;
+	char *end;
+	size_t i;
+
+	count = strtoul(p, &end, 10);
+	if (end == p)
+		return ADJ_ERR_INVALID_ARG;
+	if (count != client->table_count) {
+		table = realloc(client->table, count * sizeof(float));
+		if (count && !table)
+			return ADJ_ERR_OUT_OF_MEMORY;
+		client->table = table;
+		client->table_count = count;
+	}
+	for (i = 0; i < count; i++) {
+		p = end;
+		client->table[i] = strtof(p, &end);
+		if (end == p)
+			return ADJ_ERR_INVALID_ARG;
+	}
+
+	return 0;
+}
+
+/*
+ * Next complete line, NUL terminated in place, with its length including the newline.
+ * Pushed tables are stored on the way, they are no answer. NULL with err set otherwise.
+ */
+static char *next_line(ryzenadj_client client, const int nonblock, size_t *bytes, int *err)
+{
+	char *nl;
+
+	for (;;) {
+		nl = client->len ? memchr(client->buf, '\n', client->len) : NULL;
+		if (!nl) {
+			*err = receive(client, nonblock);
+			if (*err)
+				return NULL;
+			continue;
+		}
+		*nl = '\0';
+		*bytes = nl - client->buf + 1;
+		if (strncmp(client->buf, "sample ", 7))
+			return client->buf;
+		if (!store_table(client, client->buf + 7))
+			client->table_pending = 1;
+		consume(client, *bytes);
+	}
+}
+
+//send one command, payload receives what follows "ok", valid until the next request
+static int request(ryzenadj_client client, const char *command, const char **payload)
+{
+	const size_t size = strlen(command);
+	size_t sent = 0, bytes;
+	const char *line;
+	ssize_t n;
+	long code;
+	int err;
+
+	consume(client, client->answered);
+	client->answered = 0;
+
+	while (sent < size) {
+		n = send(client->fd, command + sent, size - sent, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return ADJ_ERR_SMU_UNAVAILABLE;
+		sent += n;
+	}
+
+	line = next_line(client, 0, &bytes, &err);
+	if (!line)
+		return err;
+	client->answered = bytes;
+
+	if (!strncmp(line, "ok", 2) && (!line[2] || line[2] == ' ')) {
+		if (payload)
+			*payload = line[2] ? line + 3 : line + 2;
+		return 0;
+	}
+	code = strncmp(line, "error ", 6) ? 0 : strtol(line + 6, NULL, 10);
+	return code < 0 ? (int)code : ADJ_ERR_INVALID_ARG;
+}
+
+EXP int CALL client_set_setting(ryzenadj_client client, enum ryzen_setting setting, uint32_t value)
+{
+	const char *name = smu_op_name(setting);
+	char command[64];
+
+	if (!name)
+		return ADJ_ERR_INVALID_ARG;
+	if (smu_op_is_switch(setting))
+		snprintf(command, sizeof(command), "set %s\n", name);
+	else
+		snprintf(command, sizeof(command), "set %s %u\n", name, value);
+
+	return request(client, command, NULL);
+}
+
+EXP float CALL client_get_setting_limit(ryzenadj_client client, enum ryzen_setting setting)
+{
+	const char *name = smu_op_name(setting);
+	const char *payload;
+	char command[64];
+
+	if (!name)
+		return NAN;
+	snprintf(command, sizeof(command), "get %s\n", name);
+	if (request(client, command, &payload))
+		return NAN;
+
+	return strtof(payload, NULL);
+}
+
+EXP int CALL client_refresh_table(ryzenadj_client client)
+{
+	const char *payload;
+	int err;
+
+	err = request(client, "refresh\n", NULL);
+	if (!err)
+		err = request(client, "dump\n", &payload);
+	if (!err)
+		err = store_table(client, payload);
+
+	return err;
+}
+
+EXP size_t CALL client_get_table_size(ryzenadj_client client)
+{
+	return client->table_count * sizeof(float);
+}
+
+EXP float* CALL client_get_table_values(ryzenadj_client client)
+{
+	return client->table;
+}
+
+EXP intptr_t CALL client_get_fd(ryzenadj_client client)
+{
+	return client->fd;
+}
+
+EXP int CALL client_schedule_refresh(ryzenadj_client client, uint32_t interval_ms, client_refresh_cb callback, void *ctx)
+{
+	char command[32];
+
+	client->callback = callback;
+	client->ctx = ctx;
+	snprintf(command, sizeof(command), "subscribe %u\n", interval_ms);
+
+	return request(client, command, NULL);
+}
+
+EXP int CALL client_dispatch(ryzenadj_client client)
+{
+	size_t bytes;
+	int events = 0, err;
+
+	//the previous answer was read by its caller already
+	consume(client, client->answered);
+	client->answered = 0;
+
+	//pushed tables are stored by next_line, anything else was not asked for
+	while (next_line(client, 1, &bytes, &err))
+		consume(client, bytes);
+
+	if (client->table_pending) {
+		client->table_pending = 0;
+		events++;
+		if (client->callback)
+			client->callback(client, 0, client->ctx);
+	}
+
+	return err == ADJ_ERR_WOULD_BLOCK ? events : err;
+}
@@ -39,7 +39,7 @@ static enum ryzen_family cpuid_load_family()
     *(uint32_t *) &vendor[8] = regs[2];
 
     if (strncmp(vendor, CPUID_VENDOR_AMD, strlen(CPUID_VENDOR_AMD))) {
-        printf("Not AMD processor, must be kidding\n");
+        ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_FAM_UNSUPPORTED, "Not AMD processor, must be kidding");
         return FAM_UNKNOWN;
     }
 
@@ -67,7 +67,7 @@ static enum ryzen_family cpuid_load_family()
         case 160:
             return FAM_MENDOCINO;
         default:
-            printf("Fam%xh: unsupported model %d\n", family, model);
+            ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_FAM_UNSUPPORTED, "Fam%xh: unsupported model %d", family, model);
             break;
         };
         break;
@@ -87,7 +87,7 @@ static enum ryzen_family cpuid_load_family()
         case 117:
             return FAM_HAWKPOINT;
         default:
-            printf("Fam%xh: unsupported model %d\n", family, model);
+            ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_FAM_UNSUPPORTED, "Fam%xh: unsupported model %d", family, model);
             break;
         };
         break;
@@ -103,16 +103,16 @@ static enum ryzen_family cpuid_load_family()
         case 112:
             return FAM_STRIXHALO;
         default:
-            printf("Fam%xh: unsupported model %d\n", family, model);
+            ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_FAM_UNSUPPORTED, "Fam%xh: unsupported model %d", family, model);
             break;
         }
 
     default:
-        printf("Unsupported family: %xh\n", family);
+        ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_FAM_UNSUPPORTED, "Unsupported family: %xh", family);
         break;
     }
 
-    printf("Only Ryzen Mobile Series are supported\n");
+    ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_FAM_UNSUPPORTED, "Only Ryzen Mobile Series are supported");
     return FAM_UNKNOWN;
 }
 
@@ -129,3 +129,11 @@ enum ryzen_family cpuid_get_family() {
 
     return cpuid_family;
 }
+
+/* raw family/model/stepping signature, identifies the exact CPU model */
+uint32_t cpuid_get_signature() {
+    uint32_t regs[4];
+
+    getcpuid(regs, 1);
+    return regs[0];
+}
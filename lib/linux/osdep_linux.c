@@ -1,6 +1,13 @@
 // SPDX-License-Identifier: LGPL
 /* Copyright (C) 2018-2019 Jiaxun Yang <jiaxun.yang@flygoat.com> */
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "osdep_linux_mem.h"
 #include "osdep_linux_smu_kernel_module.h"
@@ -36,12 +43,12 @@ os_access_obj_t *init_os_access_obj() {
 	struct stat stats;
 
 	if (lstat("/sys/kernel/ryzen_smu_drv", &stats) == 0 && is_ryzen_smu_driver_compatible()) {
-		fprintf(stderr, "detected compatible ryzen_smu kernel module\n");
+		ADJ_LOG(LOG_LEVEL_INFO, 0, "detected compatible ryzen_smu kernel module");
 		is_smu = true;
 		return init_os_access_obj_kmod();
 	}
 
-	fprintf(stderr, "no compatible ryzen_smu kernel module found, fallback to /dev/mem\n");
+	ADJ_LOG(LOG_LEVEL_INFO, 0, "no compatible ryzen_smu kernel module found, fallback to /dev/mem");
 	return init_os_access_obj_mem();
 }
 
@@ -92,3 +99,118 @@ int compare_pm_table(const void *buffer, const size_t size) {
 bool is_using_smu_driver() {
 	return is_smu;
 }
+
+uint64_t get_monotonic_time_ns() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t get_thread_cpu_time_ns() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void get_syscall_cost(const os_access_obj_t *obj, struct os_syscall_cost *cost) {
+	if (is_smu) {
+		//ryzen_smu sysfs files: lseek + write (+ lseek + read for reads)
+		cost->smn_read = 4;
+		cost->smn_write = 2;
+		cost->pm_table_copy = 2;
+	} else {
+		//libpci config space access per address and data register, PM table is mmapped
+		cost->smn_read = 2;
+		cost->smn_write = 2;
+		cost->pm_table_copy = 0;
+	}
+}
+
+int get_boot_id(char *buf, size_t size) {
+	FILE *f = fopen("/proc/sys/kernel/random/boot_id", "r");
+	size_t len;
+
+	if (f == NULL)
+		return -1;
+
+	if (!fgets(buf, (int)size, f)) {
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+
+	len = strcspn(buf, "\n");
+	buf[len] = '\0';
+	return len ? 0 : -1;
+}
+
+//epoll fd over a timerfd for deadlines and an eventfd for wakeups from other threads
+struct _os_wait_obj {
+	int epoll_fd;
+	int timer_fd;
+	int event_fd;
+};
+
+os_wait_obj_t *os_wait_obj_init() {
+	struct epoll_event ev = { .events = EPOLLIN };
+	os_wait_obj_t *obj = calloc(1, sizeof(*obj));
+
+	if (obj == NULL)
+		return NULL;
+
+	obj->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	obj->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	obj->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (obj->epoll_fd < 0 || obj->timer_fd < 0 || obj->event_fd < 0 ||
+	    epoll_ctl(obj->epoll_fd, EPOLL_CTL_ADD, obj->timer_fd, &ev) ||
+	    epoll_ctl(obj->epoll_fd, EPOLL_CTL_ADD, obj->event_fd, &ev)) {
+		os_wait_obj_free(obj);
+		return NULL;
+	}
+
+	return obj;
+}
+
+intptr_t os_wait_obj_get_fd(const os_wait_obj_t *obj) {
+	return obj->epoll_fd;
+}
+
+void os_wait_obj_arm(os_wait_obj_t *obj, uint64_t deadline_ns) {
+	struct itimerspec its = { 0 };
+
+	//same clock as get_monotonic_time_ns, 0 disarms
+	its.it_value.tv_sec = (time_t)(deadline_ns / 1000000000ull);
+	its.it_value.tv_nsec = (long)(deadline_ns % 1000000000ull);
+	timerfd_settime(obj->timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+void os_wait_obj_wake(os_wait_obj_t *obj) {
+	uint64_t one = 1;
+
+	if (write(obj->event_fd, &one, sizeof(one)) < 0)
+		DBG("eventfd write failed\n");
+}
+
+void os_wait_obj_clear(os_wait_obj_t *obj) {
+	uint64_t count;
+
+	while (read(obj->timer_fd, &count, sizeof(count)) > 0)
+		;
+	while (read(obj->event_fd, &count, sizeof(count)) > 0)
+		;
+}
+
+void os_wait_obj_free(os_wait_obj_t *obj) {
+	if (obj == NULL)
+		return;
+
+	if (obj->epoll_fd >= 0)
+		close(obj->epoll_fd);
+	if (obj->timer_fd >= 0)
+		close(obj->timer_fd);
+	if (obj->event_fd >= 0)
+		close(obj->event_fd);
+	free(obj);
+}
@@ -22,7 +22,7 @@ os_access_obj_t *init_os_access_obj_mem() {
 
 	obj->access.mem.pci_acc = pci_alloc();
 	if (!obj->access.mem.pci_acc) {
-		fprintf(stderr, "pci_alloc failed\n");
+		ADJ_LOG(LOG_LEVEL_ERROR, 0, "pci_alloc failed");
 		goto err_exit;
 	}
 
@@ -30,7 +30,7 @@ os_access_obj_t *init_os_access_obj_mem() {
 
 	obj->access.mem.pci_dev = pci_get_dev(obj->access.mem.pci_acc, 0, 0, 0, 0);
 	if (!obj->access.mem.pci_dev) {
-		fprintf(stderr, "Unable to get pci device\n");
+		ADJ_LOG(LOG_LEVEL_ERROR, 0, "Unable to get pci device");
 		pci_cleanup(obj->access.mem.pci_acc);
 		goto err_exit;
 	}
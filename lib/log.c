@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj logging to a caller supplied callback */
+#include <stdarg.h>
+
+#include "ryzenadj.h"
+
+#define LOG_MESSAGE_MAX 256
+
+volatile int log_max_level = -1;
+static ryzen_log_cb log_callback;
+static void *log_ctx;
+
+EXP void CALL set_log_callback(ryzen_log_cb callback, void *ctx, enum ryzen_log_level max_level)
+{
+	//stop emitting while the sink changes
+	log_max_level = -1;
+	log_callback = callback;
+	log_ctx = ctx;
+	if (callback)
+		log_max_level = max_level;
+}
+
+void log_emit(const int level, const int error, const char *fmt, ...)
+{
+	const ryzen_log_cb callback = log_callback;
+	char message[LOG_MESSAGE_MAX];
+	va_list ap;
+
+	if (!callback)
+		return;
+
+	va_start(ap, fmt);
+	vsnprintf(message, sizeof(message), fmt, ap);
+	va_end(ap);
+
+	callback(log_ctx, (enum ryzen_log_level)level, error, message);
+}
@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj logging to a caller supplied callback */
+/* Do not include this file! */
+
+#pragma once
+
+/* same values as enum ryzen_log_level, usable from the OS layer which doesn't see ryzenadj.h */
+#define LOG_LEVEL_ERROR    0
+#define LOG_LEVEL_WARN     1
+#define LOG_LEVEL_INFO     2
+#define LOG_LEVEL_DEBUG    3
+
+/* highest level a sink listens to, -1 without sink */
+extern volatile int log_max_level;
+
+void log_emit(int level, int error, const char *fmt, ...)
+#ifdef __GNUC__
+	__attribute__((format(printf, 3, 4)))
+#endif
+	;
+
+/* arguments are only evaluated and formatted when a sink listens to LEVEL */
+#define ADJ_LOG(LEVEL, ERR, ...)                         \
+do {                                                     \
+	if ((LEVEL) <= log_max_level)                        \
+		log_emit((LEVEL), (ERR), __VA_ARGS__);           \
+} while (0)
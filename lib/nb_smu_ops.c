@@ -2,8 +2,10 @@
 /* Copyright (C) 2018-2019 Jiaxun Yang <jiaxun.yang@flygoat.com> */
 /* Ryzen NB SMU Service Request Operations */
 #include <stdlib.h>
+#include <string.h>
 
 #include "ryzenadj.h"
+#include "atomics.h"
 
 #define MP1_C2PMSG_MESSAGE_ADDR_1        0x3B10528
 #define MP1_C2PMSG_RESPONSE_ADDR_1       0x3B10564
@@ -42,37 +44,178 @@ static uint32_t c2pmsg_argX_addr(const uint32_t base, const uint32_t offt) {
 	return base + 4 * offt;
 }
 
-uint32_t smu_service_req(smu_t smu, const uint32_t id, smu_service_args_t *args) {
+/* SMN goes through one address/data register pair, mailboxes served by different threads must not interleave */
+static os_mutex_t smn_lock = OS_MUTEX_INIT;
+
+static uint32_t smn_read(const smu_t smu, const uint32_t addr) {
+	uint32_t data;
+
+	os_mutex_lock(&smn_lock);
+	data = smn_reg_read(smu->os_access, addr);
+	os_mutex_unlock(&smn_lock);
+
+	if (smu->ctx) {
+		atomic_fetch_add_u64(&smu->ctx->counters.smn_reads, 1);
+		atomic_fetch_add_u64(&smu->ctx->counters.syscalls, smu->ctx->syscall_cost.smn_read);
+	}
+	return data;
+}
+
+static void smn_write(const smu_t smu, const uint32_t addr, const uint32_t data) {
+	os_mutex_lock(&smn_lock);
+	smn_reg_write(smu->os_access, addr, data);
+	os_mutex_unlock(&smn_lock);
+
+	if (smu->ctx) {
+		atomic_fetch_add_u64(&smu->ctx->counters.smn_writes, 1);
+		atomic_fetch_add_u64(&smu->ctx->counters.syscalls, smu->ctx->syscall_cost.smn_write);
+	}
+}
+
+struct smu_waiter {
+	struct smu_waiter *next;
+	enum SMU_CLASS cls;
+	uint64_t since_ns;
+	int granted;
+};
+
+static uint64_t class_ready_at(const smu_t smu, const enum SMU_CLASS cls, const uint64_t now) {
+	const uint64_t interval = smu->ctx ? smu->ctx->min_interval_ns[cls] : 0;
+
+	if (!interval || !smu->last_send_ns[cls] || now - smu->last_send_ns[cls] >= interval)
+		return 0;
+	return smu->last_send_ns[cls] + interval;
+}
+
+uint64_t smu_starvation_ns(const smu_t smu) {
+	return smu->ctx ? smu->ctx->starvation_ns : SMU_STARVATION_NS_DEFAULT;
+}
+
+uint64_t smu_class_ready_at(smu_t smu, const enum SMU_CLASS cls, const uint64_t now) {
+	uint64_t ready_at;
+
+	os_mutex_lock(&smu->lock);
+	ready_at = class_ready_at(smu, cls, now);
+	os_mutex_unlock(&smu->lock);
+	return ready_at;
+}
+
+/*
+ * Hand the idle mailbox to one waiter, called with smu->lock held. Rate limited classes
+ * are skipped. A waiter past the starvation limit goes first, otherwise the highest
+ * class, first come first served within a class.
+ */
+static void grant_mailbox(smu_t smu, const uint64_t now) {
+	const uint64_t starvation_ns = smu_starvation_ns(smu);
+	struct smu_waiter **link, **best = NULL;
+	uint64_t ready_at;
+
+	smu->retry_at = 0;
+	for (link = &smu->waiters; *link; link = &(*link)->next) {
+		ready_at = class_ready_at(smu, (*link)->cls, now);
+		if (ready_at) {
+			if (!smu->retry_at || ready_at < smu->retry_at)
+				smu->retry_at = ready_at;
+			continue;
+		}
+		if (now - (*link)->since_ns > starvation_ns) {
+			best = link;
+			break;
+		}
+		if (!best || (*link)->cls < (*best)->cls)
+			best = link;
+	}
+	if (!best)
+		return;
+
+	(*best)->granted = 1;
+	smu->last_send_ns[(*best)->cls] = now;
+	*best = (*best)->next;
+	smu->busy = 1;
+	os_cond_broadcast(&smu->cond);
+}
+
+static void acquire_mailbox(smu_t smu, const enum SMU_CLASS cls) {
+	struct smu_waiter self = { NULL, cls, get_monotonic_time_ns(), 0 };
+	struct smu_waiter **tail;
+	uint64_t now;
+
+	os_mutex_lock(&smu->lock);
+	for (tail = &smu->waiters; *tail; tail = &(*tail)->next)
+		;
+	*tail = &self;
+
+	for (now = self.since_ns; ; now = get_monotonic_time_ns()) {
+		if (!smu->busy)
+			grant_mailbox(smu, now);
+		if (self.granted)
+			break;
+		if (!smu->busy && smu->retry_at)
+			os_cond_timedwait_ms(&smu->cond, &smu->lock,
+					     (uint32_t)((smu->retry_at - now + 999999) / 1000000));
+		else
+			os_cond_wait(&smu->cond, &smu->lock);
+	}
+	os_mutex_unlock(&smu->lock);
+}
+
+static void release_mailbox(smu_t smu) {
+	os_mutex_lock(&smu->lock);
+	smu->busy = 0;
+	if (smu->waiters)
+		grant_mailbox(smu, get_monotonic_time_ns());
+	//nobody granted, waiters that slept untimed on the busy mailbox must switch to waiting for retry_at
+	if (!smu->busy)
+		os_cond_broadcast(&smu->cond);
+	os_mutex_unlock(&smu->lock);
+}
+
+uint32_t smu_service_req(smu_t smu, const enum SMU_CLASS cls, const uint32_t id, smu_service_args_t *args) {
+	struct trace_ring *trace = smu->ctx ? smu->ctx->trace : NULL;
+	const uint64_t arrive_ns = trace ? get_monotonic_time_ns() : 0;
+	const uint32_t arg0 = args->arg0;
+	uint64_t start_ns = 0;
 	uint32_t response = 0x0;
+
+	acquire_mailbox(smu, cls);
+	if (smu->ctx)
+		atomic_fetch_add_u64(&smu->ctx->counters.smu_messages[smu->type], 1);
+	if (trace)
+		start_ns = get_monotonic_time_ns();
 	DBG("SMU_SERVICE REQ_ID:0x%x\n", id);
 	DBG("SMU_SERVICE REQ: arg0: 0x%x, arg1:0x%x, arg2:0x%x, arg3:0x%x, arg4: 0x%x, arg5: 0x%x\n",  \
 		args->arg0, args->arg1, args->arg2, args->arg3, args->arg4, args->arg5);
 
 	/* Clear the response */
-	smn_reg_write(smu->os_access, smu->rep, 0x0);
+	smn_write(smu, smu->rep, 0x0);
 	/* Pass arguments */
-	smn_reg_write(smu->os_access, c2pmsg_argX_addr(smu->arg_base, 0), args->arg0);
-	smn_reg_write(smu->os_access, c2pmsg_argX_addr(smu->arg_base, 1), args->arg1);
-	smn_reg_write(smu->os_access, c2pmsg_argX_addr(smu->arg_base, 2), args->arg2);
-	smn_reg_write(smu->os_access, c2pmsg_argX_addr(smu->arg_base, 3), args->arg3);
-	smn_reg_write(smu->os_access, c2pmsg_argX_addr(smu->arg_base, 4), args->arg4);
-	smn_reg_write(smu->os_access, c2pmsg_argX_addr(smu->arg_base, 5), args->arg5);
+	smn_write(smu, c2pmsg_argX_addr(smu->arg_base, 0), args->arg0);
+	smn_write(smu, c2pmsg_argX_addr(smu->arg_base, 1), args->arg1);
+	smn_write(smu, c2pmsg_argX_addr(smu->arg_base, 2), args->arg2);
+	smn_write(smu, c2pmsg_argX_addr(smu->arg_base, 3), args->arg3);
+	smn_write(smu, c2pmsg_argX_addr(smu->arg_base, 4), args->arg4);
+	smn_write(smu, c2pmsg_argX_addr(smu->arg_base, 5), args->arg5);
 	/* Send message ID */
-	smn_reg_write(smu->os_access, smu->msg, id);
+	smn_write(smu, smu->msg, id);
 	/* Wait until response changed */
 	while(response == 0x0) {
-		response = smn_reg_read(smu->os_access, smu->rep);
+		response = smn_read(smu, smu->rep);
 	}
 	/* Read back arguments */
-	args->arg0 = smn_reg_read(smu->os_access, c2pmsg_argX_addr(smu->arg_base, 0));
-	args->arg1 = smn_reg_read(smu->os_access, c2pmsg_argX_addr(smu->arg_base, 1));
-	args->arg2 = smn_reg_read(smu->os_access, c2pmsg_argX_addr(smu->arg_base, 2));
-	args->arg3 = smn_reg_read(smu->os_access, c2pmsg_argX_addr(smu->arg_base, 3));
-	args->arg4 = smn_reg_read(smu->os_access, c2pmsg_argX_addr(smu->arg_base, 4));
-	args->arg5 = smn_reg_read(smu->os_access, c2pmsg_argX_addr(smu->arg_base, 5));
+	args->arg0 = smn_read(smu, c2pmsg_argX_addr(smu->arg_base, 0));
+	args->arg1 = smn_read(smu, c2pmsg_argX_addr(smu->arg_base, 1));
+	args->arg2 = smn_read(smu, c2pmsg_argX_addr(smu->arg_base, 2));
+	args->arg3 = smn_read(smu, c2pmsg_argX_addr(smu->arg_base, 3));
+	args->arg4 = smn_read(smu, c2pmsg_argX_addr(smu->arg_base, 4));
+	args->arg5 = smn_read(smu, c2pmsg_argX_addr(smu->arg_base, 5));
 
 	DBG("SMU_SERVICE REP: REP: 0x%x, arg0: 0x%x, arg1:0x%x, arg2:0x%x, arg3:0x%x, arg4: 0x%x, arg5: 0x%x\n",  \
 		response, args->arg0, args->arg1, args->arg2, args->arg3, args->arg4, args->arg5);
+	release_mailbox(smu);
+
+	if (trace)
+		trace_record(trace, TRACE_SMU_REQ, start_ns, get_monotonic_time_ns() - start_ns, smu->type, cls, id,
+			     arg0, response, start_ns - arrive_ns);
 
 	return response;
 }
@@ -82,32 +225,35 @@ static int smu_service_test(smu_t smu)
 	uint32_t response = 0x0;
 
 	/* Clear the response */
-	smn_reg_write(smu->os_access, smu->rep, 0x0);
+	smn_write(smu, smu->rep, 0x0);
 	/* Test message with unique argument */
-	smn_reg_write(smu->os_access, smu->arg_base, 0x47);
-	if(smn_reg_read(smu->os_access, smu->arg_base) != 0x47){
-		printf("PCI Bus is not writeable, check secure boot\n");
+	smn_write(smu, smu->arg_base, 0x47);
+	if(smn_read(smu, smu->arg_base) != 0x47){
+		ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_MEMORY_ACCESS, "PCI Bus is not writeable, check secure boot");
 		return 0;
 	}
 
 	/* Send message ID */
-	smn_reg_write(smu->os_access, smu->msg, SMU_TEST_MSG);
+	smn_write(smu, smu->msg, SMU_TEST_MSG);
 	/* Wait until response changed */
 	while(response == 0x0) {
-		response = smn_reg_read(smu->os_access, smu->rep);
+		response = smn_read(smu, smu->rep);
 	}
 
 	return response == REP_MSG_OK;
 }
 
-smu_t get_smu(os_access_obj_t *obj, const int smu_type) {
-	smu_t smu = malloc(sizeof(*smu));
-
-	if (smu == NULL)
-		return NULL;
-
-	smu->os_access = obj;
+static void init_arbiter(smu_t smu, struct smu_context *ctx) {
+	os_mutex_init(&smu->lock);
+	os_cond_init(&smu->cond);
+	smu->busy = 0;
+	smu->waiters = NULL;
+	smu->retry_at = 0;
+	memset(smu->last_send_ns, 0, sizeof(smu->last_send_ns));
+	smu->ctx = ctx;
+}
 
+static int fill_smu_layout(smu_t smu, const int smu_type) {
 	/* Fill SMU information */
 	switch(smu_type){
 		case TYPE_MP1:
@@ -158,10 +304,25 @@ smu_t get_smu(os_access_obj_t *obj, const int smu_type) {
 			break;
 		default:
 			DBG("Failed to get SMU, unknown SMU_TYPE: %i\n", smu_type);
-			goto err;
-			break;
+			return -1;
 	}
 
+	return 0;
+}
+
+smu_t get_smu(os_access_obj_t *obj, const int smu_type, struct smu_context *ctx) {
+	smu_t smu = malloc(sizeof(*smu));
+
+	if (smu == NULL)
+		return NULL;
+
+	smu->os_access = obj;
+	smu->type = smu_type;
+	init_arbiter(smu, ctx);
+
+	if (fill_smu_layout(smu, smu_type))
+		goto err;
+
 	if(smu_service_test(smu)){
 		return smu;
 	} else {
@@ -169,6 +330,36 @@ smu_t get_smu(os_access_obj_t *obj, const int smu_type) {
 		goto err;
 	}
 err:
-	free(smu);
+	free_smu(smu);
 	return NULL;
 }
+
+/* mailbox remembered e.g. by the init cache, used without test message if it is the layout of this family */
+smu_t get_smu_at(os_access_obj_t *obj, const int smu_type, const uint32_t msg, const uint32_t rep,
+		 const uint32_t arg_base, struct smu_context *ctx) {
+	smu_t smu = malloc(sizeof(*smu));
+
+	if (smu == NULL)
+		return NULL;
+
+	smu->os_access = obj;
+	smu->type = smu_type;
+	init_arbiter(smu, ctx);
+
+	if (fill_smu_layout(smu, smu_type) || smu->msg != msg || smu->rep != rep || smu->arg_base != arg_base) {
+		DBG("Unexpected SMU mailbox layout, SMU_TYPE: %i\n", smu_type);
+		free_smu(smu);
+		return NULL;
+	}
+
+	return smu;
+}
+
+void free_smu(smu_t smu) {
+	if (smu == NULL)
+		return;
+
+	os_cond_destroy(&smu->cond);
+	os_mutex_destroy(&smu->lock);
+	free(smu);
+}
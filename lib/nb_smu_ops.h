@@ -12,6 +12,9 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "os_thread.h"
+#include "log.h"
+
 #ifdef NDEBUG
 #define DBG(...)
 #else
@@ -61,11 +64,62 @@ typedef struct {
 #endif
 } os_access_obj_t;
 
+/* priority classes of SMU traffic, lower value is served first */
+enum SMU_CLASS {
+	CLASS_CRITICAL,
+	CLASS_CONTROL,
+	CLASS_TELEMETRY,
+	CLASS_COUNT,
+};
+
+#define SMU_STARVATION_NS_DEFAULT    100000000ull
+
+/* system calls one backend operation costs, 0 for plain memory access */
+struct os_syscall_cost {
+	uint32_t smn_read;
+	uint32_t smn_write;
+	uint32_t pm_table_copy;
+};
+
+/* self-accounting of one handle, updated from any thread with relaxed atomics */
+struct smu_counters {
+	volatile uint64_t smu_messages[TYPE_COUNT];
+	volatile uint64_t smn_reads;
+	volatile uint64_t smn_writes;
+	volatile uint64_t syscalls;
+	volatile uint64_t bytes_copied;
+	volatile uint64_t refreshes;
+	volatile uint64_t retries;
+	volatile uint64_t cpu_ns;
+};
+
+struct trace_ring;
+
+/* shared by the mailboxes of one handle */
+struct smu_context {
+	uint64_t min_interval_ns[CLASS_COUNT];   /* rate limit per class, 0 for none */
+	uint64_t starvation_ns;                  /* waited longer: served before higher classes */
+	struct trace_ring *trace;                /* NULL unless tracing is enabled */
+	struct os_syscall_cost syscall_cost;
+	struct smu_counters counters;
+};
+
+struct smu_waiter;
+
 typedef struct _smu_t {
 	os_access_obj_t *os_access;
+	enum SMU_TYPE type;
 	uint32_t msg;
 	uint32_t rep;
 	uint32_t arg_base;
+	/* arbiter, one request at a time from sync callers and queue workers */
+	os_mutex_t lock;
+	os_cond_t cond;
+	int busy;
+	struct smu_waiter *waiters;      /* arrival order */
+	uint64_t retry_at;               /* all waiters rate limited until then */
+	uint64_t last_send_ns[CLASS_COUNT];
+	struct smu_context *ctx;         /* NULL: no rate limits, default starvation limit, no accounting */
 } *smu_t;
 
 os_access_obj_t *init_os_access_obj();
@@ -77,6 +131,27 @@ void free_os_access_obj(os_access_obj_t *obj);
 uint32_t smn_reg_read(const os_access_obj_t *obj, uint32_t addr);
 void smn_reg_write(const os_access_obj_t *obj, uint32_t addr, uint32_t data);
 bool is_using_smu_driver();
+uint64_t get_monotonic_time_ns();
+int get_boot_id(char *buf, size_t size);
+/* CPU time of the calling thread */
+uint64_t get_thread_cpu_time_ns();
+void get_syscall_cost(const os_access_obj_t *obj, struct os_syscall_cost *cost);
+
+/* one pollable object (fd on Linux, HANDLE on Windows) that becomes readable when an
+ * armed monotonic deadline passes or when os_wait_obj_wake is called from any thread */
+typedef struct _os_wait_obj os_wait_obj_t;
+os_wait_obj_t *os_wait_obj_init();
+intptr_t os_wait_obj_get_fd(const os_wait_obj_t *obj);
+void os_wait_obj_arm(os_wait_obj_t *obj, uint64_t deadline_ns);
+void os_wait_obj_wake(os_wait_obj_t *obj);
+void os_wait_obj_clear(os_wait_obj_t *obj);
+void os_wait_obj_free(os_wait_obj_t *obj);
 
-smu_t get_smu(os_access_obj_t *obj, int smu_type);
-uint32_t smu_service_req(smu_t smu, uint32_t id, smu_service_args_t *args);
+smu_t get_smu(os_access_obj_t *obj, int smu_type, struct smu_context *ctx);
+void free_smu(smu_t smu);
+smu_t get_smu_at(os_access_obj_t *obj, int smu_type, uint32_t msg, uint32_t rep, uint32_t arg_base,
+		 struct smu_context *ctx);
+uint32_t smu_service_req(smu_t smu, enum SMU_CLASS cls, uint32_t id, smu_service_args_t *args);
+/* time from which cls may send again, 0 if it may send now */
+uint64_t smu_class_ready_at(smu_t smu, enum SMU_CLASS cls, uint64_t now);
+uint64_t smu_starvation_ns(const smu_t smu);
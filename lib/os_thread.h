@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj minimal thread, mutex and condition variable helpers for win32 and pthread */
+
+#pragma once
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <stdint.h>
+
+typedef HANDLE os_thread_t;
+#define OS_THREAD_PROC(NAME, ARG) DWORD WINAPI NAME(LPVOID ARG)
+#define OS_THREAD_EXIT return 0
+
+static __inline int os_thread_create(os_thread_t *thread, LPTHREAD_START_ROUTINE proc, void *arg)
+{
+	*thread = CreateThread(NULL, 0, proc, arg, 0, NULL);
+	return *thread ? 0 : -1;
+}
+
+static __inline void os_thread_join(os_thread_t thread)
+{
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+}
+
+static __inline uint32_t os_thread_id(void)
+{
+	return (uint32_t)GetCurrentThreadId();
+}
+
+static __inline unsigned os_cpu_count(void)
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors;
+}
+
+typedef SRWLOCK os_mutex_t;
+typedef CONDITION_VARIABLE os_cond_t;
+#define OS_MUTEX_INIT SRWLOCK_INIT
+
+static __inline void os_mutex_init(os_mutex_t *mutex) { InitializeSRWLock(mutex); }
+static __inline void os_mutex_destroy(os_mutex_t *mutex) { (void)mutex; }
+static __inline void os_mutex_lock(os_mutex_t *mutex) { AcquireSRWLockExclusive(mutex); }
+static __inline void os_mutex_unlock(os_mutex_t *mutex) { ReleaseSRWLockExclusive(mutex); }
+
+static __inline void os_cond_init(os_cond_t *cond) { InitializeConditionVariable(cond); }
+static __inline void os_cond_destroy(os_cond_t *cond) { (void)cond; }
+static __inline void os_cond_wait(os_cond_t *cond, os_mutex_t *mutex) { SleepConditionVariableSRW(cond, mutex, INFINITE, 0); }
+static __inline void os_cond_timedwait_ms(os_cond_t *cond, os_mutex_t *mutex, uint32_t ms) { SleepConditionVariableSRW(cond, mutex, ms, 0); }
+static __inline void os_cond_signal(os_cond_t *cond) { WakeConditionVariable(cond); }
+static __inline void os_cond_broadcast(os_cond_t *cond) { WakeAllConditionVariable(cond); }
+
+#else
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef pthread_t os_thread_t;
+#define OS_THREAD_PROC(NAME, ARG) void *NAME(void *ARG)
+#define OS_THREAD_EXIT return NULL
+
+static inline int os_thread_create(os_thread_t *thread, void *(*proc)(void *), void *arg)
+{
+	return pthread_create(thread, NULL, proc, arg) ? -1 : 0;
+}
+
+static inline void os_thread_join(os_thread_t thread)
+{
+	pthread_join(thread, NULL);
+}
+
+static inline uint32_t os_thread_id(void)
+{
+#ifdef SYS_gettid
+	return (uint32_t)syscall(SYS_gettid);
+#else
+	return (uint32_t)(uintptr_t)pthread_self();
+#endif
+}
+
+static inline unsigned os_cpu_count(void)
+{
+	const long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (unsigned)n : 1;
+}
+
+typedef pthread_mutex_t os_mutex_t;
+typedef pthread_cond_t os_cond_t;
+#define OS_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+
+static inline void os_mutex_init(os_mutex_t *mutex) { pthread_mutex_init(mutex, NULL); }
+static inline void os_mutex_destroy(os_mutex_t *mutex) { pthread_mutex_destroy(mutex); }
+static inline void os_mutex_lock(os_mutex_t *mutex) { pthread_mutex_lock(mutex); }
+static inline void os_mutex_unlock(os_mutex_t *mutex) { pthread_mutex_unlock(mutex); }
+
+static inline void os_cond_init(os_cond_t *cond) { pthread_cond_init(cond, NULL); }
+static inline void os_cond_destroy(os_cond_t *cond) { pthread_cond_destroy(cond); }
+static inline void os_cond_wait(os_cond_t *cond, os_mutex_t *mutex) { pthread_cond_wait(cond, mutex); }
+static inline void os_cond_signal(os_cond_t *cond) { pthread_cond_signal(cond); }
+static inline void os_cond_broadcast(os_cond_t *cond) { pthread_cond_broadcast(cond); }
+
+static inline void os_cond_timedwait_ms(os_cond_t *cond, os_mutex_t *mutex, uint32_t ms)
+{
+	struct timespec ts;
+
+	//default condattr clock is CLOCK_REALTIME
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += ms / 1000;
+	ts.tv_nsec += (long)(ms % 1000) * 1000000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+	pthread_cond_timedwait(cond, mutex, &ts);
+}
+
+#endif
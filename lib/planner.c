@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj setting order planner */
+#include <math.h>
+
+#include "ryzenadj.h"
+#include "planner.h"
+
+/* lower <= upper must hold before, during and after a change */
+static const struct {
+	uint32_t lower;
+	uint32_t upper;
+} relations[] = {
+	{ ADJ_STAPM_LIMIT, ADJ_SLOW_LIMIT },
+	{ ADJ_SLOW_LIMIT, ADJ_FAST_LIMIT },
+	{ ADJ_STAPM_LIMIT, ADJ_FAST_LIMIT },
+	{ ADJ_VRM_CURRENT, ADJ_VRMMAX_CURRENT },
+	{ ADJ_VRMSOC_CURRENT, ADJ_VRMSOCMAX_CURRENT },
+	{ ADJ_VRMGFX_CURRENT, ADJ_VRMGFXMAX_CURRENT },
+	{ ADJ_MIN_GFXCLK_FREQ, ADJ_MAX_GFXCLK_FREQ },
+	{ ADJ_MIN_SOCCLK_FREQ, ADJ_MAX_SOCCLK_FREQ },
+	{ ADJ_MIN_FCLK_FREQ, ADJ_MAX_FCLK_FREQ },
+	{ ADJ_MIN_VCN, ADJ_MAX_VCN },
+	{ ADJ_MIN_LCLK, ADJ_MAX_LCLK },
+};
+
+#define RELATION_COUNT (sizeof(relations) / sizeof(relations[0]))
+
+/* settings without a relation between them go in the order the CLI always sent them */
+static const uint8_t send_order[] = {
+	ADJ_STAPM_LIMIT, ADJ_FAST_LIMIT, ADJ_SLOW_LIMIT, ADJ_SLOW_TIME, ADJ_STAPM_TIME, ADJ_TCTL_TEMP,
+	ADJ_VRM_CURRENT, ADJ_VRMSOC_CURRENT, ADJ_VRMGFX_CURRENT, ADJ_VRMCVIP_CURRENT, ADJ_VRMMAX_CURRENT,
+	ADJ_VRMSOCMAX_CURRENT, ADJ_VRMGFXMAX_CURRENT, ADJ_PSI0_CURRENT, ADJ_PSI3CPU_CURRENT, ADJ_PSI0SOC_CURRENT,
+	ADJ_PSI3GFX_CURRENT, ADJ_MAX_SOCCLK_FREQ, ADJ_MIN_SOCCLK_FREQ, ADJ_MAX_FCLK_FREQ, ADJ_MIN_FCLK_FREQ,
+	ADJ_MAX_VCN, ADJ_MIN_VCN, ADJ_MAX_LCLK, ADJ_MIN_LCLK, ADJ_MAX_GFXCLK_FREQ, ADJ_MIN_GFXCLK_FREQ,
+	ADJ_PROCHOT_DEASSERTION_RAMP, ADJ_APU_SKIN_TEMP_LIMIT, ADJ_DGPU_SKIN_TEMP_LIMIT, ADJ_APU_SLOW_LIMIT,
+	ADJ_SKIN_TEMP_POWER_LIMIT, ADJ_GFX_CLK, ADJ_OC_CLK, ADJ_PER_CORE_OC_CLK, ADJ_OC_VOLT, ADJ_POWER_SAVING,
+	ADJ_MAX_PERFORMANCE, ADJ_ENABLE_OC, ADJ_DISABLE_OC, ADJ_COALL, ADJ_COPER, ADJ_COGFX,
+};
+
+typedef char send_order_complete[sizeof(send_order) == ADJ_SETTING_COUNT ? 1 : -1];
+
+//relations hold if either side is unknown
+static int fits(const float lower, const float upper)
+{
+	return isnan(lower) || isnan(upper) || lower <= upper;
+}
+
+//value the setting ends up with, NAN if it is neither written nor known
+static float final_value(const uint32_t *values, const float *current, const uint32_t setting)
+{
+	return values[setting] != PROFILE_UNSET ? (float)values[setting] : current[setting];
+}
+
+int plan_has_pair(const uint32_t *values)
+{
+	uint32_t r;
+
+	for (r = 0; r < RELATION_COUNT; r++) {
+		if (values[relations[r].lower] != PROFILE_UNSET && values[relations[r].upper] != PROFILE_UNSET)
+			return 1;
+	}
+
+	return 0;
+}
+
+int plan_order(const uint32_t *values, const float *current, uint32_t *order, uint32_t *count)
+{
+	//bit s of first[setting]: setting s has to be written before setting, ADJ_SETTING_COUNT fits in 64 bits
+	uint64_t first[ADJ_SETTING_COUNT] = {0};
+	uint64_t todo = 0;
+	uint32_t r, i, setting, n = 0;
+	int err = 0;
+
+	for (r = 0; r < RELATION_COUNT; r++) {
+		const uint32_t lower = relations[r].lower, upper = relations[r].upper;
+		int lower_first, upper_first;
+
+		if (!fits(final_value(values, current, lower), final_value(values, current, upper))) {
+			ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_INVALID_ARG, "%s %g would exceed %s %g", smu_op_name(lower),
+				final_value(values, current, lower), smu_op_name(upper), final_value(values, current, upper));
+			err = ADJ_ERR_INVALID_ARG;
+		}
+
+		if (values[lower] == PROFILE_UNSET || values[upper] == PROFILE_UNSET)
+			continue;
+		//lower first passes through (new lower, old upper), upper first through (old lower, new upper)
+		lower_first = fits(values[lower], current[upper]);
+		upper_first = fits(current[lower], values[upper]);
+		if (lower_first && !upper_first)
+			first[upper] |= 1ull << lower;
+		else if (upper_first && !lower_first)
+			first[lower] |= 1ull << upper;
+	}
+
+	for (setting = 0; setting < ADJ_SETTING_COUNT; setting++) {
+		if (values[setting] != PROFILE_UNSET)
+			todo |= 1ull << setting;
+	}
+
+	//send order unless a relation holds a setting back
+	while (todo) {
+		for (i = 0; i < ADJ_SETTING_COUNT; i++) {
+			setting = send_order[i];
+			if ((todo & (1ull << setting)) && !(first[setting] & todo))
+				break;
+		}
+		//relations contradicting each other, take the next one in send order
+		if (i == ADJ_SETTING_COUNT) {
+			for (i = 0; !(todo & (1ull << send_order[i])); i++)
+				;
+			setting = send_order[i];
+		}
+		order[n++] = setting;
+		todo &= ~(1ull << setting);
+	}
+
+	*count = n;
+	return err;
+}
@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj setting order planner */
+/* Do not include this file! */
+
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Order the settings of values (PROFILE_UNSET: not written) so that every intermediate
+ * state keeps the limit relations, current holds the limits in effect (NAN: unknown).
+ * Returns ADJ_ERR_INVALID_ARG if the final values break a relation, order is filled anyway.
+ */
+int plan_order(const uint32_t *values, const float *current, uint32_t *order, uint32_t *count);
+/* values writes both settings of a relation, only then the order depends on current limits */
+int plan_has_pair(const uint32_t *values);
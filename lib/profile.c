@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj profile files */
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ryzenadj.h"
+#include "profile.h"
+
+#define PROFILE_LINE_MAX 512
+
+static char *trim(char *s)
+{
+	char *end;
+
+	while (isspace((unsigned char)*s))
+		s++;
+	end = s + strlen(s);
+	while (end > s && isspace((unsigned char)end[-1]))
+		end--;
+	*end = '\0';
+	return s;
+}
+
+static int parse_value(const char *s, uint32_t *value)
+{
+	char *end;
+	long long v;
+
+	if (!strcmp(s, "true") || !strcmp(s, "on") || !strcmp(s, "yes")) {
+		*value = 1;
+		return 0;
+	}
+	if (!strcmp(s, "false") || !strcmp(s, "off") || !strcmp(s, "no")) {
+		*value = 0;
+		return 0;
+	}
+
+	//negative values for curve optimizer offsets become two's complement like on the CLI,
+	//-1 is PROFILE_UNSET and rejected by the caller
+	v = strtoll(s, &end, 0);
+	if (end == s || *end || v < -2147483648LL || v > 0xFFFFFFFFLL)
+		return ADJ_ERR_INVALID_ARG;
+
+	*value = (uint32_t)v;
+	return 0;
+}
+
+int profile_parse(const char *path, const char *section, uint32_t *values)
+{
+	char buf[PROFILE_LINE_MAX];
+	int in_section = !section, found = !section;
+	int err = 0, lineno = 0, setting;
+	char *line, *eq, *key;
+	uint32_t value;
+	size_t len;
+	FILE *f;
+	int c;
+
+	for (setting = 0; setting < ADJ_SETTING_COUNT; setting++)
+		values[setting] = PROFILE_UNSET;
+
+	f = fopen(path, "r");
+	if (!f) {
+		ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_NOT_AVAILABLE, "Unable to open profile %s", path);
+		return ADJ_ERR_NOT_AVAILABLE;
+	}
+
+	while (!err && fgets(buf, sizeof(buf), f)) {
+		lineno++;
+		len = strlen(buf);
+		//fgets splits longer lines, the rest would be parsed as a line of its own
+		if (len == sizeof(buf) - 1 && buf[len - 1] != '\n' && (c = fgetc(f)) != EOF && c != '\n') {
+			ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_INVALID_ARG, "%s:%d: line too long", path, lineno);
+			err = ADJ_ERR_INVALID_ARG;
+			break;
+		}
+		line = trim(buf);
+		if (!*line || *line == ';' || *line == '#')
+			continue;
+
+		if (*line == '[') {
+			eq = strchr(line, ']');
+			if (!eq) {
+				ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_INVALID_ARG, "%s:%d: unterminated section", path, lineno);
+				err = ADJ_ERR_INVALID_ARG;
+				break;
+			}
+			*eq = '\0';
+			in_section = section && !strcmp(trim(line + 1), section);
+			found |= in_section;
+			continue;
+		}
+		if (!in_section)
+			continue;
+
+		eq = strchr(line, '=');
+		if (!eq) {
+			ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_INVALID_ARG, "%s:%d: expected setting = value", path, lineno);
+			err = ADJ_ERR_INVALID_ARG;
+			break;
+		}
+		*eq = '\0';
+		key = trim(line);
+		line = trim(eq + 1);
+		//trailing comments
+		eq = strpbrk(line, ";#");
+		if (eq) {
+			*eq = '\0';
+			line = trim(line);
+		}
+
+		setting = find_setting_by_name(key);
+		if (setting < 0) {
+			ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_INVALID_ARG, "%s:%d: unknown setting %s", path, lineno, key);
+			err = ADJ_ERR_INVALID_ARG;
+		} else if (parse_value(line, &value)) {
+			ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_INVALID_ARG, "%s:%d: invalid value %s", path, lineno, line);
+			err = ADJ_ERR_INVALID_ARG;
+		} else if (values[setting] != PROFILE_UNSET) {
+			ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_INVALID_ARG, "%s:%d: %s is set twice", path, lineno, key);
+			err = ADJ_ERR_INVALID_ARG;
+		} else if (value == PROFILE_UNSET) {
+			//the CLI treats the max value as unset as well
+			ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_INVALID_ARG, "%s:%d: invalid value %s", path, lineno, line);
+			err = ADJ_ERR_INVALID_ARG;
+		} else if (!smu_op_is_switch(setting) || value) {
+			values[setting] = value;
+		}
+	}
+	fclose(f);
+
+	if (!err && !found) {
+		ADJ_LOG(LOG_LEVEL_ERROR, ADJ_ERR_INVALID_ARG, "%s: no section [%s]", path, section);
+		err = ADJ_ERR_INVALID_ARG;
+	}
+
+	return err;
+}
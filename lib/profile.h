@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj profile files */
+/* Do not include this file! */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "smu_ops.h"
+
+#define PROFILE_UNSET 0xFFFFFFFFu
+
+/* one setting, resolved to the messages of the family with the scaled argument */
+struct profile_step {
+	uint32_t setting;
+	uint32_t value;                  /* as written in the profile */
+	uint32_t arg;                    /* value * scale */
+	enum SMU_CLASS cls;
+	uint32_t count;
+	struct smu_op_msg msgs[SMU_OP_MAX_MSGS];
+};
+
+struct _ryzen_profile {
+	int family;                      /* compiled for */
+	uint32_t count;
+	struct profile_step steps[];
+};
+
+/* values of the keys outside any section or in [section], PROFILE_UNSET for absent settings */
+int profile_parse(const char *path, const char *section, uint32_t *values);
@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj PM table recording file format */
+/* Do not include this file! */
+
+/*
+ * All integers are little endian.
+ *
+ * File header (REC_HEADER_SIZE bytes)
+ *   u8[8]  magic "RYZREC\0\1"
+ *   u32    format version
+ *   u32    header size
+ *   u32    table_ver
+ *   u32    table_size (bytes)
+ *   i32    family
+ *   u32    max frames per block
+ *   u64    timestamp of first frame (ns)
+ *   u64    offset of the index, 0 if the recording was not closed properly
+ *   u8[16] reserved
+ *
+ * Block, repeated
+ *   u32    magic "BLK1"
+ *   u32    payload size (bytes after the block header)
+ *   u32    frame count
+ *   u32    reserved
+ *   u64    timestamp of first frame (ns)
+ *   u64    timestamp of last frame (ns)
+ *   payload:
+ *     key frame: table_size bytes of raw floats
+ *     delta frames:
+ *       varint timestamp delta to the previous frame (ns)
+ *       u8[group_bytes] group map: bit g set if any field of g*64 .. g*64+63 changed
+ *       for every set group: u8[8] change map, bit i set if field g*64+i changed
+ *       for every changed field: u8 control, high nibble leading zero bytes,
+ *         low nibble trailing zero bytes of (new ^ old), then the remaining
+ *         middle bytes of the xor value, least significant first
+ *
+ * Index (at index offset)
+ *   u32    magic "IDX1"
+ *   u32    block count
+ *   per block: u64 first timestamp, u64 last timestamp, u64 file offset of block,
+ *              u32 frame count, u32 reserved
+ *
+ * Constant fields cost one bit in the change map, and a frame without any
+ * change costs the timestamp delta plus the group map.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#define REC_MAGIC              "RYZREC\0\1"
+#define REC_FORMAT_VERSION     1
+#define REC_HEADER_SIZE        64
+#define REC_BLOCK_MAGIC        0x314B4C42 /* "BLK1" */
+#define REC_BLOCK_HEADER_SIZE  32
+#define REC_INDEX_MAGIC        0x31584449 /* "IDX1" */
+#define REC_INDEX_ENTRY_SIZE   32
+#define REC_GROUP_FIELDS       64
+#define REC_DEFAULT_BLOCK_FRAMES 256
+
+#define REC_HDR_OFF_VERSION      8
+#define REC_HDR_OFF_HEADER_SIZE  12
+#define REC_HDR_OFF_TABLE_VER    16
+#define REC_HDR_OFF_TABLE_SIZE   20
+#define REC_HDR_OFF_FAMILY       24
+#define REC_HDR_OFF_BLOCK_FRAMES 28
+#define REC_HDR_OFF_START_TIME   32
+#define REC_HDR_OFF_INDEX        40
+
+struct rec_index_entry {
+	uint64_t first_ts;
+	uint64_t last_ts;
+	uint64_t offset;
+	uint32_t frame_count;
+};
+
+static inline uint32_t rec_group_count(const uint32_t fields)
+{
+	return (fields + REC_GROUP_FIELDS - 1) / REC_GROUP_FIELDS;
+}
+
+static inline uint32_t rec_group_map_bytes(const uint32_t fields)
+{
+	return (rec_group_count(fields) + 7) / 8;
+}
+
+/* worst case size of a delta frame, used to bound the block buffer */
+static inline size_t rec_max_delta_frame_size(const uint32_t fields)
+{
+	return 10 + rec_group_map_bytes(fields) + rec_group_count(fields) * 8 + (size_t)fields * 5;
+}
+
+static inline void rec_put_u32(uint8_t *p, const uint32_t v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+static inline void rec_put_u64(uint8_t *p, const uint64_t v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+static inline uint32_t rec_get_u32(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t rec_get_u64(const uint8_t *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline size_t rec_put_varint(uint8_t *p, uint64_t v)
+{
+	size_t n = 0;
+
+	while (v >= 0x80) {
+		p[n++] = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	p[n++] = (uint8_t)v;
+	return n;
+}
+
+/* returns bytes consumed, 0 on truncated input */
+static inline size_t rec_get_varint(const uint8_t *p, const size_t avail, uint64_t *v)
+{
+	size_t n = 0;
+	unsigned shift = 0;
+
+	*v = 0;
+	while (n < avail && shift < 64) {
+		*v |= (uint64_t)(p[n] & 0x7F) << shift;
+		if (!(p[n++] & 0x80))
+			return n;
+		shift += 7;
+	}
+	return 0;
+}
@@ -0,0 +1,500 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj PM table recording reader */
+#include <stdlib.h>
+#include <string.h>
+
+#include "ryzenadj_rec.h"
+#include "recording.h"
+#include "os_thread.h"
+
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+struct _rec_reader {
+	const uint8_t *data;
+	size_t size;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#endif
+	uint32_t table_ver;
+	uint32_t table_size;
+	uint32_t fields;
+	enum ryzen_family family;
+	struct rec_index_entry *index;
+	uint32_t block_count;
+	uint64_t frame_count;
+};
+
+/* fields selected by a query, slot is the position inside the values passed to the callback */
+struct rec_selection {
+	int32_t *slot_of_field;
+	uint32_t *field_of_slot;
+	uint32_t count;
+};
+
+static inline unsigned ctz64(const uint64_t v)
+{
+#ifdef _MSC_VER
+	unsigned long idx;
+	_BitScanForward64(&idx, v);
+	return (unsigned)idx;
+#else
+	return (unsigned)__builtin_ctzll(v);
+#endif
+}
+
+static int map_file(rec_reader r, const char *path)
+{
+#ifdef _WIN32
+	LARGE_INTEGER size;
+
+	r->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+			      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (r->file == INVALID_HANDLE_VALUE)
+		return -1;
+	if (!GetFileSizeEx(r->file, &size) || size.QuadPart < REC_HEADER_SIZE)
+		return -1;
+	r->size = (size_t)size.QuadPart;
+	r->mapping = CreateFileMappingA(r->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!r->mapping)
+		return -1;
+	r->data = MapViewOfFile(r->mapping, FILE_MAP_READ, 0, 0, 0);
+	return r->data ? 0 : -1;
+#else
+	struct stat st;
+	void *map;
+	const int fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) || st.st_size < REC_HEADER_SIZE) {
+		close(fd);
+		return -1;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+
+	r->data = map;
+	r->size = st.st_size;
+	return 0;
+#endif
+}
+
+static void unmap_file(rec_reader r)
+{
+#ifdef _WIN32
+	if (r->data)
+		UnmapViewOfFile(r->data);
+	if (r->mapping)
+		CloseHandle(r->mapping);
+	if (r->file && r->file != INVALID_HANDLE_VALUE)
+		CloseHandle(r->file);
+#else
+	if (r->data)
+		munmap((void *)r->data, r->size);
+#endif
+}
+
+static int append_index_entry(rec_reader r, uint32_t *capacity, const uint64_t offset)
+{
+	const uint8_t *blk = r->data + offset;
+	struct rec_index_entry *entry;
+
+	if (*capacity == r->block_count) {
+		*capacity = *capacity ? *capacity * 2 : 64;
+		entry = realloc(r->index, *capacity * sizeof(*entry));
+		if (!entry)
+			return -1;
+		r->index = entry;
+	}
+
+	entry = &r->index[r->block_count++];
+	entry->offset = offset;
+	entry->frame_count = rec_get_u32(blk + 8);
+	entry->first_ts = rec_get_u64(blk + 16);
+	entry->last_ts = rec_get_u64(blk + 24);
+	r->frame_count += entry->frame_count;
+	return 0;
+}
+
+static int valid_block(const rec_reader r, const uint64_t offset)
+{
+	return offset + REC_BLOCK_HEADER_SIZE <= r->size &&
+	       rec_get_u32(r->data + offset) == REC_BLOCK_MAGIC &&
+	       offset + REC_BLOCK_HEADER_SIZE + rec_get_u32(r->data + offset + 4) <= r->size;
+}
+
+static int load_index(rec_reader r)
+{
+	const uint64_t index_offset = rec_get_u64(r->data + REC_HDR_OFF_INDEX);
+	uint64_t offset;
+	uint32_t capacity = 0, count, i;
+
+	if (index_offset && index_offset + 8 <= r->size &&
+	    rec_get_u32(r->data + index_offset) == REC_INDEX_MAGIC) {
+		count = rec_get_u32(r->data + index_offset + 4);
+		if (index_offset + 8 + (uint64_t)count * REC_INDEX_ENTRY_SIZE <= r->size) {
+			for (i = 0; i < count; i++) {
+				offset = rec_get_u64(r->data + index_offset + 8 + (uint64_t)i * REC_INDEX_ENTRY_SIZE + 16);
+				if (!valid_block(r, offset) || append_index_entry(r, &capacity, offset))
+					return -1;
+			}
+			return 0;
+		}
+	}
+
+	//recording was not closed, walk the block headers
+	offset = rec_get_u32(r->data + REC_HDR_OFF_HEADER_SIZE);
+	while (valid_block(r, offset)) {
+		if (append_index_entry(r, &capacity, offset))
+			return -1;
+		offset += REC_BLOCK_HEADER_SIZE + rec_get_u32(r->data + offset + 4);
+	}
+
+	return 0;
+}
+
+EXP rec_reader CALL rec_reader_open(const char *path)
+{
+	rec_reader r = calloc(1, sizeof(*r));
+
+	if (!r)
+		return NULL;
+
+	if (map_file(r, path))
+		goto err_exit;
+
+	if (memcmp(r->data, REC_MAGIC, 8) ||
+	    rec_get_u32(r->data + REC_HDR_OFF_VERSION) != REC_FORMAT_VERSION)
+		goto err_exit;
+
+	r->table_ver = rec_get_u32(r->data + REC_HDR_OFF_TABLE_VER);
+	r->table_size = rec_get_u32(r->data + REC_HDR_OFF_TABLE_SIZE);
+	r->family = (enum ryzen_family)(int32_t)rec_get_u32(r->data + REC_HDR_OFF_FAMILY);
+	r->fields = r->table_size / 4;
+	if (!r->fields || load_index(r))
+		goto err_exit;
+
+	return r;
+
+err_exit:
+	rec_reader_close(r);
+	return NULL;
+}
+
+EXP void CALL rec_reader_close(rec_reader r)
+{
+	if (r == NULL)
+		return;
+
+	unmap_file(r);
+	free(r->index);
+	free(r);
+}
+
+EXP uint32_t CALL rec_reader_table_ver(rec_reader r) { return r->table_ver; }
+EXP uint32_t CALL rec_reader_table_size(rec_reader r) { return r->table_size; }
+EXP enum ryzen_family CALL rec_reader_family(rec_reader r) { return r->family; }
+EXP uint64_t CALL rec_reader_frame_count(rec_reader r) { return r->frame_count; }
+
+EXP uint64_t CALL rec_reader_first_ts(rec_reader r)
+{
+	return r->block_count ? r->index[0].first_ts : 0;
+}
+
+EXP uint64_t CALL rec_reader_last_ts(rec_reader r)
+{
+	return r->block_count ? r->index[r->block_count - 1].last_ts : 0;
+}
+
+/* first block which may contain frames at or after t0 */
+static uint32_t find_block(const rec_reader r, const uint64_t t0)
+{
+	uint32_t lo = 0, hi = r->block_count, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (r->index[mid].last_ts < t0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static int decode_block(const rec_reader r, const struct rec_index_entry *entry, const uint64_t t0, const uint64_t t1,
+			const struct rec_selection *sel, uint32_t *bits, rec_frame_cb cb, void *ctx)
+{
+	const uint8_t *p = r->data + entry->offset + REC_BLOCK_HEADER_SIZE;
+	const uint8_t *end = p + rec_get_u32(r->data + entry->offset + 4);
+	const uint32_t group_map_bytes = rec_group_map_bytes(r->fields);
+	const uint32_t groups = rec_group_count(r->fields);
+	uint64_t ts = entry->first_ts, dt, changed;
+	const uint8_t *group_map, *change_map;
+	uint32_t frame, g, i, field, x, lead, trail, n;
+	int ret;
+
+	if ((size_t)(end - p) < r->table_size)
+		return ADJ_ERR_MEMORY_ACCESS;
+	for (i = 0; i < sel->count; i++)
+		bits[i] = rec_get_u32(p + sel->field_of_slot[i] * 4);
+	p += r->table_size;
+
+	for (frame = 0; frame < entry->frame_count; frame++) {
+		if (frame) {
+			n = (uint32_t)rec_get_varint(p, end - p, &dt);
+			if (!n || (size_t)(end - p) < n + group_map_bytes)
+				return ADJ_ERR_MEMORY_ACCESS;
+			ts += dt;
+			group_map = p + n;
+			change_map = group_map + group_map_bytes;
+			for (g = 0, n = 0; g < groups; g++)
+				n += (group_map[g / 8] >> (g % 8)) & 1;
+			p = change_map + n * 8;
+			if (p > end)
+				return ADJ_ERR_MEMORY_ACCESS;
+
+			for (g = 0; g < groups; g++) {
+				if (!((group_map[g / 8] >> (g % 8)) & 1))
+					continue;
+				changed = rec_get_u64(change_map);
+				change_map += 8;
+				while (changed) {
+					field = g * REC_GROUP_FIELDS + ctz64(changed);
+					changed &= changed - 1;
+					if (p >= end || field >= r->fields)
+						return ADJ_ERR_MEMORY_ACCESS;
+					lead = *p >> 4;
+					trail = *p & 0xF;
+					p++;
+					if (lead + trail > 3 || p + 4 - lead - trail > end)
+						return ADJ_ERR_MEMORY_ACCESS;
+					if (sel->slot_of_field[field] >= 0) {
+						for (x = 0, n = trail; n < 4 - lead; n++)
+							x |= (uint32_t)p[n - trail] << (8 * n);
+						bits[sel->slot_of_field[field]] ^= x;
+					}
+					p += 4 - lead - trail;
+				}
+			}
+		}
+
+		//callers only decode blocks starting at or before t1, so the first later frame ends the range
+		if (ts > t1)
+			return 0;
+		if (ts >= t0) {
+			ret = cb(ctx, ts, (const float *)bits);
+			if (ret)
+				return ret;
+		}
+	}
+
+	return 0;
+}
+
+static int init_selection(const rec_reader r, struct rec_selection *sel, const uint32_t *offsets, const uint32_t count)
+{
+	uint32_t i;
+
+	sel->count = count;
+	sel->slot_of_field = malloc(r->fields * sizeof(*sel->slot_of_field));
+	sel->field_of_slot = malloc(count * sizeof(*sel->field_of_slot));
+	if (!sel->slot_of_field || !sel->field_of_slot)
+		return ADJ_ERR_OUT_OF_MEMORY;
+
+	for (i = 0; i < r->fields; i++)
+		sel->slot_of_field[i] = -1;
+	for (i = 0; i < count; i++) {
+		if (offsets[i] % 4 || offsets[i] / 4 >= r->fields)
+			return ADJ_ERR_INVALID_ARG;
+		//the same offset may be requested twice, the second slot then copies the first
+		sel->field_of_slot[i] = offsets[i] / 4;
+		if (sel->slot_of_field[offsets[i] / 4] < 0)
+			sel->slot_of_field[offsets[i] / 4] = i;
+	}
+
+	return 0;
+}
+
+static void free_selection(struct rec_selection *sel)
+{
+	free(sel->slot_of_field);
+	free(sel->field_of_slot);
+}
+
+struct dup_ctx {
+	const struct rec_selection *sel;
+	rec_frame_cb cb;
+	void *ctx;
+};
+
+static int fill_duplicates(void *ctx, const uint64_t timestamp_ns, const float *values)
+{
+	const struct dup_ctx *dup = ctx;
+	float *v = (float *)values;
+	uint32_t i;
+
+	for (i = 0; i < dup->sel->count; i++)
+		v[i] = v[dup->sel->slot_of_field[dup->sel->field_of_slot[i]]];
+	return dup->cb(dup->ctx, timestamp_ns, v);
+}
+
+EXP int CALL rec_read_fields(rec_reader r, uint64_t t0, uint64_t t1, const uint32_t *offsets,
+			     uint32_t offset_count, rec_frame_cb cb, void *ctx)
+{
+	struct rec_selection sel = { NULL, NULL, 0 };
+	struct dup_ctx dup;
+	uint32_t *bits, b;
+	int ret;
+
+	if (!r || !offsets || !offset_count || !cb || t0 > t1)
+		return ADJ_ERR_INVALID_ARG;
+
+	bits = malloc(offset_count * sizeof(*bits));
+	ret = bits ? init_selection(r, &sel, offsets, offset_count) : ADJ_ERR_OUT_OF_MEMORY;
+
+	dup.sel = &sel;
+	dup.cb = cb;
+	dup.ctx = ctx;
+	for (b = find_block(r, t0); !ret && b < r->block_count && r->index[b].first_ts <= t1; b++)
+		ret = decode_block(r, &r->index[b], t0, t1, &sel, bits, fill_duplicates, &dup);
+
+	free_selection(&sel);
+	free(bits);
+	return ret;
+}
+
+struct agg_bucket {
+	uint32_t count;
+	float min;
+	float max;
+	double sum;
+};
+
+struct agg_worker {
+	rec_reader r;
+	const struct rec_selection *sel;
+	uint32_t first_block;
+	uint32_t last_block;
+	uint64_t t0;
+	uint64_t t1;
+	uint64_t bucket_ns;
+	uint32_t bucket_count;
+	struct agg_bucket *buckets;
+	int ret;
+};
+
+static int aggregate_frame(void *ctx, const uint64_t timestamp_ns, const float *values)
+{
+	struct agg_worker *w = ctx;
+	struct agg_bucket *b = &w->buckets[(timestamp_ns - w->t0) / w->bucket_ns];
+
+	if (!b->count || values[0] < b->min)
+		b->min = values[0];
+	if (!b->count || values[0] > b->max)
+		b->max = values[0];
+	b->sum += values[0];
+	b->count++;
+	return 0;
+}
+
+static OS_THREAD_PROC(aggregate_worker, arg)
+{
+	struct agg_worker *w = arg;
+	uint32_t bits, b;
+
+	for (b = w->first_block; !w->ret && b < w->last_block; b++)
+		w->ret = decode_block(w->r, &w->r->index[b], w->t0, w->t1, w->sel, &bits, aggregate_frame, w);
+
+	OS_THREAD_EXIT;
+}
+
+EXP int CALL rec_aggregate(rec_reader r, uint32_t offset, uint64_t t0, uint64_t t1, uint64_t bucket_ns,
+			   struct rec_bucket_stats *out, uint32_t out_count, uint32_t threads)
+{
+	struct rec_selection sel = { NULL, NULL, 0 };
+	struct agg_worker *workers;
+	os_thread_t *handles;
+	uint32_t first, last, per_worker, started = 1, i, k;
+	int ret;
+
+	if (!r || !out || !bucket_ns || t0 > t1 || (t1 - t0) / bucket_ns >= out_count)
+		return ADJ_ERR_INVALID_ARG;
+	out_count = (uint32_t)((t1 - t0) / bucket_ns + 1);
+
+	first = find_block(r, t0);
+	for (last = first; last < r->block_count && r->index[last].first_ts <= t1; last++);
+
+	if (!threads)
+		threads = os_cpu_count();
+	if (threads > last - first)
+		threads = last - first ? last - first : 1;
+
+	workers = calloc(threads, sizeof(*workers));
+	handles = calloc(threads, sizeof(*handles));
+	ret = workers && handles ? init_selection(r, &sel, &offset, 1) : ADJ_ERR_OUT_OF_MEMORY;
+
+	//split the block range evenly, every worker reduces into its own buckets
+	per_worker = (last - first + threads - 1) / threads;
+	for (i = 0; !ret && i < threads; i++) {
+		workers[i].r = r;
+		workers[i].sel = &sel;
+		workers[i].first_block = first + i * per_worker;
+		workers[i].last_block = first + (i + 1) * per_worker < last ? first + (i + 1) * per_worker : last;
+		workers[i].t0 = t0;
+		workers[i].t1 = t1;
+		workers[i].bucket_ns = bucket_ns;
+		workers[i].bucket_count = out_count;
+		workers[i].buckets = calloc(out_count, sizeof(*workers[i].buckets));
+		if (!workers[i].buckets)
+			ret = ADJ_ERR_OUT_OF_MEMORY;
+	}
+
+	for (; !ret && started < threads; started++) {
+		if (os_thread_create(&handles[started], aggregate_worker, &workers[started]))
+			ret = ADJ_ERR_OUT_OF_MEMORY;
+	}
+	if (!ret)
+		aggregate_worker(&workers[0]);
+	for (i = 1; i < started; i++)
+		os_thread_join(handles[i]);
+
+	for (k = 0; !ret && k < out_count; k++) {
+		out[k].start_ns = t0 + k * bucket_ns;
+		out[k].count = 0;
+		out[k].min = out[k].max = out[k].mean = 0;
+		double sum = 0;
+		for (i = 0; i < threads; i++) {
+			const struct agg_bucket *b = &workers[i].buckets[k];
+			if (workers[i].ret)
+				ret = workers[i].ret;
+			if (!b->count)
+				continue;
+			if (!out[k].count || b->min < out[k].min)
+				out[k].min = b->min;
+			if (!out[k].count || b->max > out[k].max)
+				out[k].max = b->max;
+			out[k].count += b->count;
+			sum += b->sum;
+		}
+		if (out[k].count)
+			out[k].mean = (float)(sum / out[k].count);
+	}
+
+	for (i = 0; workers && i < threads; i++)
+		free(workers[i].buckets);
+	free(workers);
+	free(handles);
+	free_selection(&sel);
+	return ret;
+}
@@ -0,0 +1,282 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj PM table recording writer */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ryzenadj_rec.h"
+#include "recording.h"
+
+struct _rec_writer {
+	FILE *file;
+	uint32_t fields;
+	uint32_t block_frames;
+	uint64_t file_offset;
+	uint64_t start_ts;
+
+	/* current block */
+	uint8_t *block;
+	size_t block_len;
+	uint32_t frame_count;
+	uint64_t first_ts;
+	uint64_t last_ts;
+	uint32_t *prev;                  /* previous frame as raw bits */
+
+	/* index, one entry per block */
+	struct rec_index_entry *index;
+	uint32_t index_count;
+	uint32_t index_capacity;
+};
+
+static int write_all(rec_writer w, const void *buf, const size_t len)
+{
+	if (fwrite(buf, 1, len, w->file) != len)
+		return ADJ_ERR_MEMORY_ACCESS;
+	w->file_offset += len;
+	return 0;
+}
+
+static int write_header(rec_writer w, const uint32_t table_ver, const uint32_t table_size,
+			const enum ryzen_family family)
+{
+	uint8_t hdr[REC_HEADER_SIZE];
+
+	memset(hdr, 0, sizeof(hdr));
+	memcpy(hdr, REC_MAGIC, 8);
+	rec_put_u32(hdr + REC_HDR_OFF_VERSION, REC_FORMAT_VERSION);
+	rec_put_u32(hdr + REC_HDR_OFF_HEADER_SIZE, REC_HEADER_SIZE);
+	rec_put_u32(hdr + REC_HDR_OFF_TABLE_VER, table_ver);
+	rec_put_u32(hdr + REC_HDR_OFF_TABLE_SIZE, table_size);
+	rec_put_u32(hdr + REC_HDR_OFF_FAMILY, (uint32_t)family);
+	rec_put_u32(hdr + REC_HDR_OFF_BLOCK_FRAMES, w->block_frames);
+
+	return write_all(w, hdr, sizeof(hdr));
+}
+
+EXP rec_writer CALL rec_writer_open(const char *path, uint32_t table_ver, uint32_t table_size,
+				    enum ryzen_family family, uint32_t block_frames)
+{
+	rec_writer w;
+
+	if (!path || !table_size || table_size % 4)
+		return NULL;
+
+	w = calloc(1, sizeof(*w));
+	if (!w)
+		return NULL;
+
+	w->fields = table_size / 4;
+	w->block_frames = block_frames ? block_frames : REC_DEFAULT_BLOCK_FRAMES;
+	w->block = malloc(REC_BLOCK_HEADER_SIZE + table_size +
+			  (size_t)(w->block_frames - 1) * rec_max_delta_frame_size(w->fields));
+	w->prev = malloc(table_size);
+	if (!w->block || !w->prev)
+		goto err_exit;
+
+	w->file = fopen(path, "wb");
+	if (!w->file)
+		goto err_exit;
+
+	if (write_header(w, table_ver, table_size, family))
+		goto err_exit;
+
+	return w;
+
+err_exit:
+	if (w->file)
+		fclose(w->file);
+	free(w->block);
+	free(w->prev);
+	free(w);
+	return NULL;
+}
+
+static void append_key_frame(rec_writer w, const float *values)
+{
+	memcpy(w->block + w->block_len, values, w->fields * 4);
+	memcpy(w->prev, values, w->fields * 4);
+	w->block_len += w->fields * 4;
+}
+
+static void append_delta_frame(rec_writer w, const uint64_t ts_delta, const float *values)
+{
+	const uint32_t groups = rec_group_count(w->fields);
+	const uint32_t *cur = (const uint32_t *)values;
+	uint8_t *p = w->block + w->block_len;
+	uint8_t *group_map, *change_map, *xor_data;
+	uint32_t g, i, field, x;
+	int lead, trail, n;
+
+	p += rec_put_varint(p, ts_delta);
+	group_map = p;
+	memset(group_map, 0, rec_group_map_bytes(w->fields));
+	p += rec_group_map_bytes(w->fields);
+
+	//change maps of all groups first, xor values follow in field order
+	change_map = p;
+	for (g = 0; g < groups; g++) {
+		uint64_t bits = 0;
+		for (i = 0; i < REC_GROUP_FIELDS && g * REC_GROUP_FIELDS + i < w->fields; i++) {
+			field = g * REC_GROUP_FIELDS + i;
+			if (cur[field] != w->prev[field])
+				bits |= 1ull << i;
+		}
+		if (bits) {
+			group_map[g / 8] |= 1 << (g % 8);
+			rec_put_u64(change_map, bits);
+			change_map += 8;
+		}
+	}
+
+	xor_data = change_map;
+	for (field = 0; field < w->fields; field++) {
+		x = cur[field] ^ w->prev[field];
+		if (!x)
+			continue;
+
+		for (lead = 0; lead < 3 && !((x >> (8 * (3 - lead))) & 0xFF); lead++);
+		for (trail = 0; trail < 3 && !((x >> (8 * trail)) & 0xFF); trail++);
+		*xor_data++ = (uint8_t)(lead << 4 | trail);
+		for (n = trail; n < 4 - lead; n++)
+			*xor_data++ = (uint8_t)(x >> (8 * n));
+
+		w->prev[field] = cur[field];
+	}
+
+	w->block_len = xor_data - w->block;
+}
+
+//room for the index entry of the block about to start, so a full block can always be flushed
+static int reserve_index_entry(rec_writer w)
+{
+	struct rec_index_entry *index;
+	uint32_t capacity;
+
+	if (w->index_count < w->index_capacity)
+		return 0;
+
+	capacity = w->index_capacity ? w->index_capacity * 2 : 64;
+	index = realloc(w->index, capacity * sizeof(*index));
+	if (!index)
+		return ADJ_ERR_OUT_OF_MEMORY;
+	w->index = index;
+	w->index_capacity = capacity;
+	return 0;
+}
+
+EXP int CALL rec_writer_flush(rec_writer w)
+{
+	struct rec_index_entry *entry;
+	const uint64_t offset = w->file_offset;
+	const uint32_t frame_count = w->frame_count;
+	int err;
+
+	if (!frame_count)
+		return fflush(w->file) ? ADJ_ERR_MEMORY_ACCESS : 0;
+
+	rec_put_u32(w->block, REC_BLOCK_MAGIC);
+	rec_put_u32(w->block + 4, (uint32_t)(w->block_len - REC_BLOCK_HEADER_SIZE));
+	rec_put_u32(w->block + 8, frame_count);
+	rec_put_u32(w->block + 12, 0);
+	rec_put_u64(w->block + 16, w->first_ts);
+	rec_put_u64(w->block + 24, w->last_ts);
+
+	err = write_all(w, w->block, w->block_len);
+	w->frame_count = 0;
+	w->block_len = 0;
+	if (err)
+		return err;
+
+	//only blocks which are completely on disk get indexed, the entry was reserved by the first frame
+	entry = &w->index[w->index_count++];
+	entry->first_ts = w->first_ts;
+	entry->last_ts = w->last_ts;
+	entry->offset = offset;
+	entry->frame_count = frame_count;
+
+	return fflush(w->file) ? ADJ_ERR_MEMORY_ACCESS : 0;
+}
+
+EXP int CALL rec_writer_append(rec_writer w, uint64_t timestamp_ns, const float *values)
+{
+	int err;
+
+	if (!w || !values)
+		return ADJ_ERR_INVALID_ARG;
+
+	//across blocks as well, the reader finds time ranges by the block index
+	if ((w->index_count || w->frame_count) && timestamp_ns < w->last_ts)
+		return ADJ_ERR_INVALID_ARG;
+
+	if (!w->index_count && !w->frame_count)
+		w->start_ts = timestamp_ns;
+
+	if (!w->frame_count) {
+		err = reserve_index_entry(w);
+		if (err)
+			return err;
+		w->block_len = REC_BLOCK_HEADER_SIZE;
+		w->first_ts = timestamp_ns;
+		append_key_frame(w, values);
+	} else {
+		append_delta_frame(w, timestamp_ns - w->last_ts, values);
+	}
+
+	w->last_ts = timestamp_ns;
+	if (++w->frame_count == w->block_frames)
+		return rec_writer_flush(w);
+
+	return 0;
+}
+
+static int write_index(rec_writer w)
+{
+	uint8_t buf[REC_INDEX_ENTRY_SIZE];
+	const uint64_t index_offset = w->file_offset;
+	uint32_t i;
+	int err;
+
+	rec_put_u32(buf, REC_INDEX_MAGIC);
+	rec_put_u32(buf + 4, w->index_count);
+	err = write_all(w, buf, 8);
+
+	for (i = 0; !err && i < w->index_count; i++) {
+		memset(buf, 0, sizeof(buf));
+		rec_put_u64(buf, w->index[i].first_ts);
+		rec_put_u64(buf + 8, w->index[i].last_ts);
+		rec_put_u64(buf + 16, w->index[i].offset);
+		rec_put_u32(buf + 24, w->index[i].frame_count);
+		err = write_all(w, buf, sizeof(buf));
+	}
+	if (err)
+		return err;
+
+	//patch header, the recording is complete from now on
+	rec_put_u64(buf, w->start_ts);
+	rec_put_u64(buf + 8, index_offset);
+	if (fseek(w->file, REC_HDR_OFF_START_TIME, SEEK_SET) ||
+	    fwrite(buf, 1, 16, w->file) != 16)
+		return ADJ_ERR_MEMORY_ACCESS;
+
+	return 0;
+}
+
+EXP int CALL rec_writer_close(rec_writer w)
+{
+	int err;
+
+	if (!w)
+		return ADJ_ERR_INVALID_ARG;
+
+	err = rec_writer_flush(w);
+	if (!err)
+		err = write_index(w);
+	if (fclose(w->file) && !err)
+		err = ADJ_ERR_MEMORY_ACCESS;
+
+	free(w->index);
+	free(w->block);
+	free(w->prev);
+	free(w);
+	return err;
+}
@@ -34,9 +34,54 @@ enum ryzen_family {
         FAM_END
 };
 
-#ifdef _LIBRYZENADJ_INTERNAL
-#include  "ryzenadj_priv.h"
+enum ryzen_setting {
+        ADJ_STAPM_LIMIT = 0,
+        ADJ_FAST_LIMIT,
+        ADJ_SLOW_LIMIT,
+        ADJ_SLOW_TIME,
+        ADJ_STAPM_TIME,
+        ADJ_TCTL_TEMP,
+        ADJ_VRM_CURRENT,
+        ADJ_VRMSOC_CURRENT,
+        ADJ_VRMGFX_CURRENT,
+        ADJ_VRMCVIP_CURRENT,
+        ADJ_VRMMAX_CURRENT,
+        ADJ_VRMGFXMAX_CURRENT,
+        ADJ_VRMSOCMAX_CURRENT,
+        ADJ_PSI0_CURRENT,
+        ADJ_PSI3CPU_CURRENT,
+        ADJ_PSI0SOC_CURRENT,
+        ADJ_PSI3GFX_CURRENT,
+        ADJ_MAX_GFXCLK_FREQ,
+        ADJ_MIN_GFXCLK_FREQ,
+        ADJ_MAX_SOCCLK_FREQ,
+        ADJ_MIN_SOCCLK_FREQ,
+        ADJ_MAX_FCLK_FREQ,
+        ADJ_MIN_FCLK_FREQ,
+        ADJ_MAX_VCN,
+        ADJ_MIN_VCN,
+        ADJ_MAX_LCLK,
+        ADJ_MIN_LCLK,
+        ADJ_PROCHOT_DEASSERTION_RAMP,
+        ADJ_APU_SKIN_TEMP_LIMIT,
+        ADJ_DGPU_SKIN_TEMP_LIMIT,
+        ADJ_APU_SLOW_LIMIT,
+        ADJ_SKIN_TEMP_POWER_LIMIT,
+        ADJ_GFX_CLK,
+        ADJ_OC_CLK,
+        ADJ_PER_CORE_OC_CLK,
+        ADJ_OC_VOLT,
+        ADJ_DISABLE_OC,
+        ADJ_ENABLE_OC,
+        ADJ_POWER_SAVING,
+        ADJ_MAX_PERFORMANCE,
+        ADJ_COALL,
+        ADJ_COPER,
+        ADJ_COGFX,
+        ADJ_SETTING_COUNT
+};
 
+#ifdef _LIBRYZENADJ_INTERNAL
 #ifdef _WIN32
 #define EXP __declspec(dllexport)
 #define CALL __stdcall
@@ -54,7 +99,6 @@ enum ryzen_family {
 #define EXP
 #define CALL
 #endif
-struct _ryzen_access;
 
 #endif
 
@@ -63,10 +107,46 @@ struct _ryzen_access;
 #define ADJ_ERR_SMU_UNSUPPORTED      -3
 #define ADJ_ERR_SMU_REJECTED         -4
 #define ADJ_ERR_MEMORY_ACCESS        -5
+#define ADJ_ERR_NOT_AVAILABLE        -6
+#define ADJ_ERR_INVALID_ARG          -7
+#define ADJ_ERR_OUT_OF_MEMORY        -8
+#define ADJ_ERR_SMU_UNAVAILABLE      -9
+#define ADJ_ERR_WOULD_BLOCK          -10
+#define ADJ_ERR_VERIFY_FAILED        -11
 
 typedef struct _ryzen_access *ryzen_access;
 
+/* completion of a scheduled refresh, see ryzenadj_schedule_refresh */
+typedef void (CALL *ryzen_refresh_cb)(ryzen_access ry, int result, void *ctx);
+
+#ifdef _LIBRYZENADJ_INTERNAL
+#include  "ryzenadj_priv.h"
+#endif
+
+/*
+ * Library messages go to a process wide callback, nothing is printed without one.
+ * Levels above max_level are not even formatted. error is the ADJ_ERR_* code the
+ * message explains, 0 for none. Messages have no trailing newline.
+ */
+enum ryzen_log_level {
+	ADJ_LOG_ERROR = 0,
+	ADJ_LOG_WARN,
+	ADJ_LOG_INFO,
+	ADJ_LOG_DEBUG
+};
+
+typedef void (CALL *ryzen_log_cb)(void *ctx, enum ryzen_log_level level, int error, const char *message);
+
+EXP void CALL set_log_callback(ryzen_log_cb callback, void *ctx, enum ryzen_log_level max_level);
+
 EXP ryzen_access CALL init_ryzenadj();
+/*
+ * Opt-in init cache (NULL: $RYZENADJ_CACHE_DIR/init, /var/cache/ryzenadj/init on Linux).
+ * Holds SMU mailbox layout and PM table version, size and address, validated by boot id,
+ * CPU model and backend. A warm start skips the mailbox test messages and the table
+ * version/address requests of init_table.
+ */
+EXP ryzen_access CALL init_ryzenadj_cached(const char *path);
 
 EXP void CALL cleanup_ryzenadj(ryzen_access ry);
 
@@ -78,6 +158,247 @@ EXP uint32_t CALL get_table_ver(ryzen_access ry);
 EXP size_t CALL get_table_size(ryzen_access ry);
 EXP float* CALL get_table_values(ryzen_access ry);
 EXP int CALL refresh_table(ryzen_access ry);
+/*
+ * Non-blocking refresh_table for event loops: never sleeps. If the SMU asks for a
+ * pause it returns ADJ_ERR_WOULD_BLOCK and the delay in retry_after_ms; call again
+ * after it elapsed. Also performs the table setup of init_table on first use.
+ */
+EXP int CALL refresh_table_nb(ryzen_access ry, uint32_t *retry_after_ms);
+
+/*
+ * Event loop integration. ryzenadj_get_fd() returns an fd (a HANDLE on Windows) that
+ * becomes readable when the handle has work: a scheduled refresh is due, a transfer
+ * retry of refresh_table_nb is due or an asynchronous request completed. Call
+ * ryzenadj_dispatch() then, it never blocks, runs due work and their callbacks and
+ * returns the number of events handled. timeout_ms receives the time until the next
+ * deadline (UINT32_MAX for none) for loops that don't poll the fd.
+ * ryzenadj_schedule_refresh() refreshes the table every interval_ms from dispatch and
+ * reports each result to the callback, interval_ms 0 stops it.
+ */
+EXP intptr_t CALL ryzenadj_get_fd(ryzen_access ry);
+EXP int CALL ryzenadj_schedule_refresh(ryzen_access ry, uint32_t interval_ms, ryzen_refresh_cb callback, void *ctx);
+EXP int CALL ryzenadj_dispatch(ryzen_access ry, uint32_t *timeout_ms);
+
+/*
+ * Binary trace ring of SMU requests (mailbox, message, arg0, response, class, wait and
+ * service time), table transfers, table copies and retries. Recording is a lock free
+ * fixed size copy from any thread, the oldest events get overwritten. The exporter
+ * writes Chrome trace event JSON (chrome://tracing, ui.perfetto.dev), timestamps are
+ * the monotonic clock (CLOCK_MONOTONIC, QueryPerformanceCounter) in microseconds.
+ * Enable and disable before or after SMU traffic, not while requests are in flight.
+ */
+EXP int CALL enable_trace(ryzen_access ry, uint32_t capacity);
+EXP void CALL disable_trace(ryzen_access ry);
+EXP int CALL export_trace_json(ryzen_access ry, const char *path);
+
+/*
+ * PM table history: keep the last `capacity` refreshed tables (or only the given
+ * byte offsets) with sequence number and monotonic timestamp in nanoseconds.
+ * Memory is allocated once here, refresh_table never allocates.
+ * Readers may run concurrently with refresh_table from other threads without locking,
+ * they get ADJ_ERR_NOT_AVAILABLE if the requested entry was already overwritten.
+ */
+EXP int CALL enable_table_history(ryzen_access ry, uint32_t capacity, const uint32_t *offsets, uint32_t offset_count);
+EXP void CALL disable_table_history(ryzen_access ry);
+EXP uint64_t CALL get_table_history_seq(ryzen_access ry);
+EXP uint64_t CALL find_table_history_seq(ryzen_access ry, uint64_t timestamp_ns);
+EXP int CALL get_table_history_entry(ryzen_access ry, uint64_t seq, float *values, uint64_t *timestamp_ns);
+
+/*
+ * Windowed statistics of PM table fields, updated by every refresh_table.
+ * Windows slide in steps of a quarter of their length. Quantiles are estimated
+ * from a log scale histogram with 4 bins per power of two and clamped to min/max.
+ * Must not be read concurrently with refresh_table.
+ */
+enum ryzen_stats_window {
+	STATS_WINDOW_1S = 0,
+	STATS_WINDOW_10S,
+	STATS_WINDOW_60S,
+	STATS_WINDOW_COUNT
+};
+
+struct ryzen_field_stats {
+	uint32_t count;
+	float min;
+	float max;
+	float mean;
+	float p50;
+	float p99;
+};
+
+EXP int CALL enable_table_stats(ryzen_access ry, const uint32_t *offsets, uint32_t offset_count);
+EXP void CALL disable_table_stats(ryzen_access ry);
+EXP int CALL get_table_stats(ryzen_access ry, uint32_t offset, enum ryzen_stats_window window, struct ryzen_field_stats *stats);
+
+/*
+ * Compare two PM table snapshots of table_size bytes and report the changed offsets.
+ * An entry counts as changed when its bits differ and |new - old| exceeds both
+ * abs_threshold and rel_threshold * |old|; pass 0 for both to report every change.
+ * Fills at most max_changes entries and returns the total number of changed entries.
+ */
+struct ryzen_table_diff {
+	uint32_t offset;
+	float old_value;
+	float new_value;
+};
+
+EXP size_t CALL diff_table_values(const float *old_values, const float *new_values, size_t table_size,
+				  float abs_threshold, float rel_threshold,
+				  struct ryzen_table_diff *changes, size_t max_changes);
+
+/*
+ * Settings are resolved to SMU messages of the CPU family once by init_ryzenadj.
+ * is_setting_supported() answers without any SMU traffic, set_setting() is the
+ * indexed equivalent of the set_* functions (value is ignored for the switches).
+ */
+EXP int CALL is_setting_supported(ryzen_access ry, enum ryzen_setting setting);
+EXP int CALL set_setting(ryzen_access ry, enum ryzen_setting setting, uint32_t value);
+EXP const char* CALL get_setting_name(enum ryzen_setting setting);
+/* enable style settings, set_setting() ignores their value */
+EXP int CALL is_setting_switch(enum ryzen_setting setting);
+/* inverse of get_setting_name, also takes the CLI spelling "fast-limit"; -1 if unknown */
+EXP int CALL find_setting_by_name(const char *name);
+/*
+ * Current limit of a setting as reported by the last refreshed PM table, in the units
+ * of set_setting (mW, mA, s, degree C). NAN if the table version has no field for it.
+ */
+EXP float CALL get_setting_limit(ryzen_access ry, enum ryzen_setting setting);
+/*
+ * Largest difference between two get_setting_limit() values, or a limit and a set_setting()
+ * value, that still means the same setting: half a unit, both round to the same integer.
+ */
+#define ADJ_LIMIT_TOLERANCE 0.5f
+
+/*
+ * Messages answered with "unknown command" are remembered by the handle and not sent
+ * again, a fallback mailbox is then used directly. With a capability cache file
+ * (NULL: $RYZENADJ_CACHE_DIR/capabilities, /var/cache/ryzenadj/capabilities on Linux)
+ * this is shared with later processes of the same CPU family and BIOS interface version.
+ */
+EXP int CALL enable_capability_cache(ryzen_access ry, const char *path);
+
+/*
+ * Profiles are INI files of "setting = value" lines. Keys are the setting names with
+ * '_' or '-' (fast-limit = 30000), switches take 1/0, ';' and '#' start comments.
+ * load_profile() reads the keys outside any section, or those of [section], validates
+ * them against the family of the handle and compiles them into a list of mailbox,
+ * message and argument tuples. apply_profile() only replays that list, it sends every
+ * setting and returns the first error. Problems are logged with file and line, error
+ * (may be NULL) receives the ADJ_ERR_* code. A profile belongs to the family it was
+ * loaded for and may be applied to any handle of that family.
+ */
+typedef struct _ryzen_profile *ryzen_profile;
+
+/*
+ * Order the writes of values (ADJ_SETTING_COUNT entries, UINT32_MAX: not written) so the
+ * limit relations hold at every step: stapm <= slow <= fast, TDC <= EDC and min <= max of
+ * the clock pairs. Limits not written are taken from the last refreshed PM table, which is
+ * read first if values writes both settings of a relation. order receives count settings.
+ * Returns ADJ_ERR_INVALID_ARG, with the broken relations logged, if the final values break
+ * one; order is filled anyway. apply_profile() plans the same way and sends nothing in that
+ * case.
+ */
+EXP int CALL plan_settings(ryzen_access ry, const uint32_t *values, enum ryzen_setting *order, uint32_t *count);
+
+EXP ryzen_profile CALL load_profile(ryzen_access ry, const char *path, const char *section, int *error);
+EXP int CALL apply_profile(ryzen_access ry, ryzen_profile profile);
+/* values receives ADJ_SETTING_COUNT entries, UINT32_MAX for settings the profile leaves alone */
+EXP void CALL get_profile_values(ryzen_profile profile, uint32_t *values);
+EXP void CALL free_profile(ryzen_profile profile);
+
+/*
+ * All or nothing: snapshot the limits from one table refresh, send the settings in
+ * planned order, then verify them with one refresh per attempt until they show up in
+ * the PM table or verify_timeout_ms passed (0: a single attempt). If a setting fails or
+ * verification gives up (ADJ_ERR_VERIFY_FAILED), everything sent is restored to the
+ * snapshot and the error is returned; failed_setting (may be NULL) receives the setting,
+ * -1 if none is to blame. Only settings with a PM table field are verified and restored,
+ * get_setting_limit() tells which. Firmware clamping a value counts as a failure.
+ */
+EXP int CALL apply_settings_transaction(ryzen_access ry, const uint32_t *values, uint32_t verify_timeout_ms, int *failed_setting);
+EXP int CALL apply_profile_transaction(ryzen_access ry, ryzen_profile profile, uint32_t verify_timeout_ms, int *failed_setting);
+
+/*
+ * Temporary limits: begin_session() refreshes the PM table and captures the effective
+ * limits, error (may be NULL) receives the ADJ_ERR_* code if it returns NULL.
+ * session_apply_settings() sends values (UINT32_MAX: left alone) in planned order and
+ * skips those already in effect. end_session() restores every limit the session wrote
+ * that still differs from the captured one, frees the session and returns the first
+ * error. Settings without a PM table field, and switches, are not restored.
+ */
+typedef struct _ryzen_session *ryzen_session;
+
+EXP ryzen_session CALL begin_session(ryzen_access ry, int *error);
+EXP int CALL session_apply_settings(ryzen_access ry, ryzen_session session, const uint32_t *values);
+EXP int CALL end_session(ryzen_access ry, ryzen_session session);
+
+/*
+ * Asynchronous set_setting: the message is queued on its mailbox and sent by a worker
+ * thread per mailbox, so the call returns right away and MP1 and PSMU requests overlap.
+ * The callback runs from ryzenadj_dispatch() after the message, or its fallback on the
+ * other mailbox, completed. Requests to one mailbox are sent in submission order, there
+ * is no ordering against synchronous set_* calls. Queued requests are still sent by
+ * cleanup_ryzenadj, their callbacks are not called.
+ */
+enum ryzen_mailbox {
+	ADJ_MAILBOX_MP1 = 0,
+	ADJ_MAILBOX_PSMU,
+	ADJ_MAILBOX_COUNT
+};
+
+struct ryzen_queue_stats {
+	uint64_t submitted;
+	uint64_t completed;
+	uint32_t depth;                  /* waiting plus in service */
+	uint32_t max_depth;
+	uint64_t total_wait_ns;          /* submission until the worker sends it */
+	uint64_t max_wait_ns;
+	uint64_t total_service_ns;       /* send until the SMU answered */
+	uint64_t max_service_ns;
+};
+
+typedef void (CALL *ryzen_setting_cb)(ryzen_access ry, enum ryzen_setting setting, int result, void *ctx);
+
+EXP int CALL set_setting_async(ryzen_access ry, enum ryzen_setting setting, uint32_t value,
+			       ryzen_setting_cb callback, void *ctx);
+EXP int CALL get_smu_queue_stats(ryzen_access ry, enum ryzen_mailbox mailbox, struct ryzen_queue_stats *stats);
+
+/*
+ * SMU traffic is served per mailbox by priority class, synchronous and asynchronous
+ * alike. Thermal, power and current limits default to critical, other settings to
+ * control, table and version requests are telemetry. A class can be rate limited to
+ * one message per min_interval_us (0: unlimited). A message waiting longer than the
+ * starvation limit (default 100 ms) is served before higher classes.
+ */
+enum ryzen_smu_class {
+	ADJ_CLASS_CRITICAL = 0,
+	ADJ_CLASS_CONTROL,
+	ADJ_CLASS_TELEMETRY,
+	ADJ_CLASS_COUNT
+};
+
+EXP int CALL set_setting_class(ryzen_access ry, enum ryzen_setting setting, enum ryzen_smu_class cls);
+EXP int CALL set_smu_class_rate_limit(ryzen_access ry, enum ryzen_smu_class cls, uint32_t min_interval_us);
+EXP int CALL set_smu_starvation_limit(ryzen_access ry, uint32_t max_wait_us);
+
+/*
+ * What the handle itself cost since init or the last reset. Backend system calls are
+ * counted from a fixed cost per SMN access and table copy of the active backend, CPU
+ * time is thread time spent inside library calls and the queue workers.
+ */
+struct ryzen_self_stats {
+	uint64_t smu_messages[ADJ_MAILBOX_COUNT];
+	uint64_t smn_reads;
+	uint64_t smn_writes;
+	uint64_t syscalls;
+	uint64_t bytes_copied;           /* PM table copies */
+	uint64_t refreshes;              /* successful table refreshes */
+	uint64_t retries;                /* transfer table retries and fallbacks to the other mailbox */
+	uint64_t cpu_time_ns;
+};
+
+EXP void CALL get_self_stats(ryzen_access ry, struct ryzen_self_stats *stats);
+EXP void CALL reset_self_stats(ryzen_access ry);
 
 EXP int CALL set_stapm_limit(ryzen_access, uint32_t value);
 EXP int CALL set_fast_limit(ryzen_access, uint32_t value);
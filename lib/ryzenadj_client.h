@@ -0,0 +1,55 @@
+/* SPDX-License-Identifier: LGPL */
+/* RyzenAdj client of ryzenadjd */
+
+#ifndef RYZENADJ_CLIENT_H
+#define RYZENADJ_CLIENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ryzenadj.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The calls of ryzenadj.h for tools that talk to ryzenadjd instead of the SMU, they
+ * need neither root nor libpci. The daemon serializes the requests of all clients and
+ * shares PM tables between them. Errors are the ADJ_ERR_* codes the daemon answered,
+ * ADJ_ERR_SMU_UNAVAILABLE if the connection is gone.
+ */
+typedef struct _ryzenadj_client *ryzenadj_client;
+
+/* completion of a scheduled refresh, see client_schedule_refresh */
+typedef void (CALL *client_refresh_cb)(ryzenadj_client client, int result, void *ctx);
+
+/* path NULL: $RYZENADJD_SOCKET, or /run/ryzenadjd.sock */
+EXP ryzenadj_client CALL init_ryzenadj_client(const char *path);
+EXP void CALL cleanup_ryzenadj_client(ryzenadj_client client);
+
+EXP int CALL client_set_setting(ryzenadj_client client, enum ryzen_setting setting, uint32_t value);
+/* limit from the table the daemon refreshed last, NAN if unavailable */
+EXP float CALL client_get_setting_limit(ryzenadj_client client, enum ryzen_setting setting);
+
+/* fetch a table no older than the --min-refresh of the daemon into the client */
+EXP int CALL client_refresh_table(ryzenadj_client client);
+/* size in bytes and values of the last fetched table, NULL before the first one */
+EXP size_t CALL client_get_table_size(ryzenadj_client client);
+EXP float* CALL client_get_table_values(ryzenadj_client client);
+
+/*
+ * Event loop integration like ryzenadj_get_fd/ryzenadj_dispatch: the daemon pushes a
+ * table every interval_ms (0 stops it). When the fd is readable call client_dispatch(),
+ * it never blocks, updates the client table and runs the callback. A table that arrived
+ * during another call is delivered by the next dispatch, only the newest is kept.
+ * client_dispatch() returns the number of tables delivered or an error.
+ */
+EXP intptr_t CALL client_get_fd(ryzenadj_client client);
+EXP int CALL client_schedule_refresh(ryzenadj_client client, uint32_t interval_ms, client_refresh_cb callback, void *ctx);
+EXP int CALL client_dispatch(ryzenadj_client client);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -9,19 +9,44 @@
 #include <stdint.h>
 
 #include  "nb_smu_ops.h"
+#include  "table_history.h"
+#include  "table_stats.h"
+#include  "smu_ops.h"
+#include  "cache.h"
+#include  "smu_queue.h"
+#include  "trace.h"
+#include  "profile.h"
+#include  "planner.h"
 
 struct _ryzen_access {
 	os_access_obj_t *os_access;
 	smu_t mp1_smu;
 	smu_t psmu;
+	int smu_unavailable[TYPE_COUNT];    /* mailbox probe failed, don't retry */
 	enum ryzen_family family;
 	int bios_if_ver;
 	uintptr_t table_addr;
 	uint32_t table_ver;
 	size_t table_size;
 	float *table_values;
+	uint64_t transfer_retry_at;         /* refresh_table_nb: no SMU traffic before this time */
+	uint32_t transfer_attempt;
+	int empty_table_retried;
+	os_wait_obj_t *wait_obj;            /* created by ryzenadj_get_fd or the first async request */
+	struct smu_queue *queue[TYPE_COUNT];
+	uint32_t refresh_interval_ms;
+	uint64_t next_refresh;
+	ryzen_refresh_cb refresh_cb;
+	void *refresh_ctx;
+	struct table_history *history;
+	struct table_stats *stats;
+	struct smu_op ops[ADJ_SETTING_COUNT];
+	struct smu_context smu_ctx;
+	char *capability_cache;
+	char *init_cache;
 };
 
 enum ryzen_family cpuid_get_family();
+uint32_t cpuid_get_signature();
 
 #endif
@@ -0,0 +1,75 @@
+/* SPDX-License-Identifier: LGPL */
+/* RyzenAdj PM table recording API */
+
+#ifndef RYZENADJ_REC_H
+#define RYZENADJ_REC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ryzenadj.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _rec_writer *rec_writer;
+
+/*
+ * Stream PM tables into a compressed recording file.
+ * Memory is bounded by one block of `block_frames` frames (0 selects the default),
+ * full blocks are written out immediately, the time index is written on close.
+ * Timestamps are in nanoseconds and must not decrease.
+ */
+EXP rec_writer CALL rec_writer_open(const char *path, uint32_t table_ver, uint32_t table_size,
+				    enum ryzen_family family, uint32_t block_frames);
+EXP int CALL rec_writer_append(rec_writer w, uint64_t timestamp_ns, const float *values);
+EXP int CALL rec_writer_flush(rec_writer w);
+EXP int CALL rec_writer_close(rec_writer w);
+
+typedef struct _rec_reader *rec_reader;
+
+/* called for every frame in time order, values holds the requested fields */
+typedef int (*rec_frame_cb)(void *ctx, uint64_t timestamp_ns, const float *values);
+
+struct rec_bucket_stats {
+	uint64_t start_ns;
+	uint32_t count;
+	float min;
+	float max;
+	float mean;
+};
+
+/*
+ * Memory map a recording. Unclosed recordings are supported,
+ * the time index is then rebuilt from the block headers.
+ */
+EXP rec_reader CALL rec_reader_open(const char *path);
+EXP void CALL rec_reader_close(rec_reader r);
+EXP uint32_t CALL rec_reader_table_ver(rec_reader r);
+EXP uint32_t CALL rec_reader_table_size(rec_reader r);
+EXP enum ryzen_family CALL rec_reader_family(rec_reader r);
+EXP uint64_t CALL rec_reader_frame_count(rec_reader r);
+EXP uint64_t CALL rec_reader_first_ts(rec_reader r);
+EXP uint64_t CALL rec_reader_last_ts(rec_reader r);
+
+/*
+ * Decode the given byte offsets of all frames with t0 <= timestamp <= t1.
+ * Only blocks overlapping the range are touched. A non-zero return of the
+ * callback stops the iteration and is returned.
+ */
+EXP int CALL rec_read_fields(rec_reader r, uint64_t t0, uint64_t t1, const uint32_t *offsets,
+			     uint32_t offset_count, rec_frame_cb cb, void *ctx);
+
+/*
+ * Reduce one field to min/max/mean per bucket of bucket_ns, bucket i starts at t0 + i * bucket_ns.
+ * out must hold (t1 - t0) / bucket_ns + 1 entries. Blocks are decoded by `threads` workers,
+ * 0 uses all CPUs.
+ */
+EXP int CALL rec_aggregate(rec_reader r, uint32_t offset, uint64_t t0, uint64_t t1, uint64_t bucket_ns,
+			   struct rec_bucket_stats *out, uint32_t out_count, uint32_t threads);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
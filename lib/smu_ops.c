@@ -0,0 +1,207 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj per family SMU message dispatch */
+#include <string.h>
+
+#include "ryzenadj.h"
+
+#define FAM(F)          (1u << FAM_##F)
+#define FAMS_RAVEN      (FAM(RAVEN) | FAM(PICASSO) | FAM(DALI))
+#define FAMS_RENOIR     (FAM(RENOIR) | FAM(LUCIENNE) | FAM(CEZANNE))
+#define FAMS_REMBRANDT  (FAM(REMBRANDT) | FAM(MENDOCINO) | FAM(PHOENIX) | FAM(HAWKPOINT) | \
+			 FAM(KRACKANPOINT) | FAM(STRIXPOINT) | FAM(STRIXHALO))
+#define FAMS_APU        (FAMS_RENOIR | FAM(VANGOGH) | FAMS_REMBRANDT)
+#define FAMS_DRAGON     (FAM(DRAGONRANGE) | FAM(FIRERANGE))
+
+#define MP1(ID)         { TYPE_MP1, ID }
+#define PSMU(ID)        { TYPE_PSMU, ID }
+#define NONE            { TYPE_MP1, 0 }
+
+struct smu_op_def {
+	enum ryzen_setting setting;
+	uint32_t families;
+	struct smu_op_msg msgs[SMU_OP_MAX_MSGS];
+};
+
+/*
+ * Message table by setting and family. A family must appear at most once per
+ * setting; the second message is tried only if the first one fails.
+ */
+static const struct smu_op_def smu_op_defs[] = {
+	/* \_SB.ALIB (0x0c, [size, 0x05, val]) */
+	{ ADJ_STAPM_LIMIT, FAMS_RAVEN, { MP1(0x1a), NONE } },
+	{ ADJ_STAPM_LIMIT, FAMS_APU, { MP1(0x14), PSMU(0x31) } },
+	{ ADJ_STAPM_LIMIT, FAMS_DRAGON, { MP1(0x4f), NONE } },
+	/* \_SB.ALIB (0x0c, [size, 0x06, val]) */
+	{ ADJ_FAST_LIMIT, FAMS_RAVEN, { MP1(0x1b), NONE } },
+	{ ADJ_FAST_LIMIT, FAMS_APU, { MP1(0x15), NONE } },
+	{ ADJ_FAST_LIMIT, FAMS_DRAGON, { MP1(0x3e), NONE } },
+	/* \_SB.ALIB (0x0c, [size, 0x07, val]) */
+	{ ADJ_SLOW_LIMIT, FAMS_RAVEN, { MP1(0x1c), NONE } },
+	{ ADJ_SLOW_LIMIT, FAMS_APU, { MP1(0x16), NONE } },
+	{ ADJ_SLOW_LIMIT, FAMS_DRAGON, { MP1(0x5f), NONE } },
+	/* \_SB.ALIB (0x0c, [size, 0x08, val]) */
+	{ ADJ_SLOW_TIME, FAMS_RAVEN, { MP1(0x1d), NONE } },
+	{ ADJ_SLOW_TIME, FAMS_APU, { MP1(0x17), NONE } },
+	{ ADJ_SLOW_TIME, FAMS_DRAGON, { MP1(0x60), NONE } },
+	/* \_SB.ALIB (0x0c, [size, 0x01, val]) */
+	{ ADJ_STAPM_TIME, FAMS_RAVEN, { MP1(0x1e), NONE } },
+	{ ADJ_STAPM_TIME, FAMS_APU, { MP1(0x18), NONE } },
+	{ ADJ_STAPM_TIME, FAMS_DRAGON, { MP1(0x4e), NONE } },
+	/* \_SB.ALIB (0x0c, [size, 0x03, val]) */
+	{ ADJ_TCTL_TEMP, FAMS_RAVEN, { MP1(0x1f), NONE } },
+	{ ADJ_TCTL_TEMP, FAMS_APU, { MP1(0x19), NONE } },
+	{ ADJ_TCTL_TEMP, FAMS_DRAGON, { MP1(0x3f), NONE } },
+	/* \_SB.ALIB (0x0c, [size, 0x0b, val]) */
+	{ ADJ_VRM_CURRENT, FAMS_RAVEN, { MP1(0x20), NONE } },
+	{ ADJ_VRM_CURRENT, FAMS_APU, { MP1(0x1a), NONE } },
+	{ ADJ_VRM_CURRENT, FAMS_DRAGON, { MP1(0x3c), NONE } },
+	/* \_SB.ALIB (0x0c, [size, 0x0e, val]) */
+	{ ADJ_VRMSOC_CURRENT, FAMS_RAVEN, { MP1(0x21), NONE } },
+	{ ADJ_VRMSOC_CURRENT, FAMS_APU, { MP1(0x1b), NONE } },
+	{ ADJ_VRMGFX_CURRENT, FAM(VANGOGH), { MP1(0x1c), NONE } },
+	{ ADJ_VRMCVIP_CURRENT, FAM(VANGOGH), { MP1(0x1d), NONE } },
+	/* \_SB.ALIB (0x0c, [size, 0x0c, val]) */
+	{ ADJ_VRMMAX_CURRENT, FAMS_RAVEN, { MP1(0x22), NONE } },
+	{ ADJ_VRMMAX_CURRENT, FAMS_RENOIR | FAMS_REMBRANDT, { MP1(0x1c), NONE } },
+	{ ADJ_VRMMAX_CURRENT, FAM(VANGOGH), { MP1(0x1e), NONE } },
+	{ ADJ_VRMGFXMAX_CURRENT, FAM(VANGOGH), { MP1(0x1f), NONE } },
+	/* \_SB.ALIB (0x0c, [size, 0x11, val]) */
+	{ ADJ_VRMSOCMAX_CURRENT, FAMS_RAVEN, { MP1(0x23), NONE } },
+	{ ADJ_VRMSOCMAX_CURRENT, FAMS_RENOIR | FAMS_REMBRANDT, { MP1(0x1d), NONE } },
+	{ ADJ_PSI0_CURRENT, FAMS_RAVEN, { MP1(0x24), NONE } },
+	{ ADJ_PSI0_CURRENT, FAMS_RENOIR, { MP1(0x1e), NONE } },
+	{ ADJ_PSI3CPU_CURRENT, FAM(VANGOGH), { MP1(0x20), NONE } },
+	{ ADJ_PSI0SOC_CURRENT, FAMS_RAVEN, { MP1(0x25), NONE } },
+	{ ADJ_PSI0SOC_CURRENT, FAMS_RENOIR, { MP1(0x1f), NONE } },
+	{ ADJ_PSI3GFX_CURRENT, FAM(VANGOGH), { MP1(0x21), NONE } },
+	{ ADJ_MAX_GFXCLK_FREQ, FAMS_RAVEN | FAM(LUCIENNE), { MP1(0x46), NONE } },
+	{ ADJ_MIN_GFXCLK_FREQ, FAMS_RAVEN | FAM(LUCIENNE), { MP1(0x47), NONE } },
+	{ ADJ_MAX_SOCCLK_FREQ, FAMS_RAVEN, { MP1(0x48), NONE } },
+	{ ADJ_MIN_SOCCLK_FREQ, FAMS_RAVEN, { MP1(0x49), NONE } },
+	{ ADJ_MAX_FCLK_FREQ, FAMS_RAVEN, { MP1(0x4A), NONE } },
+	{ ADJ_MIN_FCLK_FREQ, FAMS_RAVEN, { MP1(0x4B), NONE } },
+	{ ADJ_MAX_VCN, FAMS_RAVEN, { MP1(0x4C), NONE } },
+	{ ADJ_MIN_VCN, FAMS_RAVEN, { MP1(0x4D), NONE } },
+	{ ADJ_MAX_LCLK, FAMS_RAVEN, { MP1(0x4E), NONE } },
+	{ ADJ_MIN_LCLK, FAMS_RAVEN, { MP1(0x4F), NONE } },
+	/* \_SB.ALIB (0x0c, [size, 0x09, val]) */
+	{ ADJ_PROCHOT_DEASSERTION_RAMP, FAMS_RAVEN, { MP1(0x26), NONE } },
+	{ ADJ_PROCHOT_DEASSERTION_RAMP, FAMS_RENOIR, { MP1(0x20), NONE } },
+	{ ADJ_PROCHOT_DEASSERTION_RAMP, FAM(VANGOGH), { MP1(0x22), NONE } },
+	{ ADJ_PROCHOT_DEASSERTION_RAMP, FAMS_REMBRANDT, { MP1(0x1f), NONE } },
+	/* \_SB.ALIB (0x0c, [size, 0x22, val]), not implemented on StrixHalo, seems to be controlled only via tctl-temp */
+	{ ADJ_APU_SKIN_TEMP_LIMIT, FAMS_RENOIR, { MP1(0x38), NONE } },
+	{ ADJ_APU_SKIN_TEMP_LIMIT, FAM(VANGOGH) | FAM(REMBRANDT) | FAM(MENDOCINO) | FAM(PHOENIX) | FAM(HAWKPOINT),
+	  { MP1(0x33), NONE } },
+	/* \_SB.ALIB (0x0c, [size, 0x23, val]), not implemented on StrixHalo */
+	{ ADJ_DGPU_SKIN_TEMP_LIMIT, FAMS_RENOIR, { MP1(0x39), NONE } },
+	{ ADJ_DGPU_SKIN_TEMP_LIMIT, FAM(VANGOGH) | FAM(REMBRANDT) | FAM(MENDOCINO) | FAM(PHOENIX) | FAM(HAWKPOINT) |
+	  FAM(STRIXPOINT), { MP1(0x34), NONE } },
+	/* \_SB.ALIB (0x0c, [size, 0x13, val]) */
+	{ ADJ_APU_SLOW_LIMIT, FAMS_RENOIR, { MP1(0x21), NONE } },
+	{ ADJ_APU_SLOW_LIMIT, FAMS_REMBRANDT & ~FAM(MENDOCINO), { MP1(0x23), NONE } },
+	/* \_SB.ALIB (0x0c, [size, 0x2e, val]) */
+	{ ADJ_SKIN_TEMP_POWER_LIMIT, FAMS_RENOIR, { MP1(0x53), NONE } },
+	{ ADJ_SKIN_TEMP_POWER_LIMIT, FAM(VANGOGH) | FAMS_REMBRANDT, { MP1(0x4a), NONE } },
+	{ ADJ_GFX_CLK, FAMS_APU, { PSMU(0x89), NONE } },
+	{ ADJ_OC_CLK, FAMS_RENOIR | FAM(REMBRANDT), { MP1(0x31), PSMU(0x19) } },
+	{ ADJ_PER_CORE_OC_CLK, FAMS_RENOIR | FAM(REMBRANDT), { MP1(0x32), PSMU(0x1a) } },
+	{ ADJ_OC_VOLT, FAMS_RENOIR, { MP1(0x33), PSMU(0x1b) } },
+	{ ADJ_DISABLE_OC, FAMS_RENOIR, { MP1(0x30), PSMU(0x1d) } },
+	{ ADJ_DISABLE_OC, FAM(REMBRANDT), { PSMU(0x18), NONE } },
+	{ ADJ_ENABLE_OC, FAMS_RENOIR, { MP1(0x2F), NONE } },
+	{ ADJ_ENABLE_OC, FAM(REMBRANDT), { PSMU(0x17), NONE } },
+	/* \_SB.ALIB (0x01, [size, 0x1]) */
+	{ ADJ_POWER_SAVING, FAMS_RAVEN, { MP1(0x19), NONE } },
+	{ ADJ_POWER_SAVING, FAMS_APU, { MP1(0x12), NONE } },
+	/* \_SB.ALIB (0x01, [size, 0x0]) */
+	{ ADJ_MAX_PERFORMANCE, FAMS_RAVEN, { MP1(0x18), NONE } },
+	{ ADJ_MAX_PERFORMANCE, FAMS_APU, { MP1(0x11), NONE } },
+	{ ADJ_COALL, FAMS_RENOIR, { MP1(0x55), NONE } },
+	{ ADJ_COALL, FAM(VANGOGH) | (FAMS_REMBRANDT & ~FAM(MENDOCINO)), { MP1(0x4C), NONE } },
+	{ ADJ_COALL, FAMS_DRAGON, { PSMU(0x7), NONE } },
+	{ ADJ_COPER, FAMS_RENOIR, { MP1(0x54), NONE } },
+	{ ADJ_COPER, FAM(VANGOGH) | (FAMS_REMBRANDT & ~FAM(MENDOCINO)), { MP1(0x4b), NONE } },
+	{ ADJ_COPER, FAMS_DRAGON, { PSMU(0x6), NONE } },
+	/* 0xB7 is rejected on StrixHalo */
+	{ ADJ_COGFX, FAMS_RENOIR, { MP1(0x64), NONE } },
+	{ ADJ_COGFX, FAM(VANGOGH) | FAM(REMBRANDT) | FAM(PHOENIX) | FAM(HAWKPOINT), { PSMU(0xB7), NONE } },
+};
+
+/* in order of enum ryzen_setting, names match the set_* functions */
+static const char *const smu_op_names[ADJ_SETTING_COUNT] = {
+	"stapm_limit", "fast_limit", "slow_limit", "slow_time", "stapm_time", "tctl_temp",
+	"vrm_current", "vrmsoc_current", "vrmgfx_current", "vrmcvip_current", "vrmmax_current",
+	"vrmgfxmax_current", "vrmsocmax_current", "psi0_current", "psi3cpu_current", "psi0soc_current",
+	"psi3gfx_current", "max_gfxclk_freq", "min_gfxclk_freq", "max_socclk_freq", "min_socclk_freq",
+	"max_fclk_freq", "min_fclk_freq", "max_vcn", "min_vcn", "max_lclk", "min_lclk",
+	"prochot_deassertion_ramp", "apu_skin_temp_limit", "dgpu_skin_temp_limit", "apu_slow_limit",
+	"skin_temp_power_limit", "gfx_clk", "oc_clk", "per_core_oc_clk", "oc_volt", "disable_oc",
+	"enable_oc", "power_saving", "max_performance", "coall", "coper", "cogfx",
+};
+
+/* thermal, power and current limits protect the hardware, they go ahead of tuning */
+static enum SMU_CLASS default_class(const uint32_t setting)
+{
+	switch (setting) {
+	case ADJ_STAPM_LIMIT:
+	case ADJ_FAST_LIMIT:
+	case ADJ_SLOW_LIMIT:
+	case ADJ_APU_SLOW_LIMIT:
+	case ADJ_TCTL_TEMP:
+	case ADJ_APU_SKIN_TEMP_LIMIT:
+	case ADJ_DGPU_SKIN_TEMP_LIMIT:
+	case ADJ_SKIN_TEMP_POWER_LIMIT:
+	case ADJ_VRM_CURRENT:
+	case ADJ_VRMSOC_CURRENT:
+	case ADJ_VRMGFX_CURRENT:
+	case ADJ_VRMCVIP_CURRENT:
+	case ADJ_VRMMAX_CURRENT:
+	case ADJ_VRMGFXMAX_CURRENT:
+	case ADJ_VRMSOCMAX_CURRENT:
+		return CLASS_CRITICAL;
+	default:
+		return CLASS_CONTROL;
+	}
+}
+
+void resolve_smu_ops(const enum ryzen_family family, struct smu_op *ops)
+{
+	const struct smu_op_def *def;
+	struct smu_op *op;
+	size_t i;
+	uint32_t k;
+
+	memset(ops, 0, ADJ_SETTING_COUNT * sizeof(*ops));
+	for (k = 0; k < ADJ_SETTING_COUNT; k++)
+		ops[k].cls = default_class(k);
+	if (family < 0 || family >= FAM_END)
+		return;
+
+	for (i = 0; i < sizeof(smu_op_defs) / sizeof(smu_op_defs[0]); i++) {
+		def = &smu_op_defs[i];
+		if (!(def->families & (1u << family)))
+			continue;
+
+		op = &ops[def->setting];
+		//skin temperature limits are sent in 1/256 degree C
+		op->scale = def->setting == ADJ_APU_SKIN_TEMP_LIMIT || def->setting == ADJ_DGPU_SKIN_TEMP_LIMIT ? 256 : 1;
+		for (k = 0; k < SMU_OP_MAX_MSGS && def->msgs[k].id; k++)
+			op->msgs[k] = def->msgs[k];
+		op->count = k;
+	}
+}
+
+int smu_op_is_switch(const uint32_t setting)
+{
+	return setting == ADJ_DISABLE_OC || setting == ADJ_ENABLE_OC || setting == ADJ_POWER_SAVING ||
+	       setting == ADJ_MAX_PERFORMANCE;
+}
+
+const char *smu_op_name(const uint32_t setting)
+{
+	if (setting >= ADJ_SETTING_COUNT)
+		return NULL;
+
+	return smu_op_names[setting];
+}
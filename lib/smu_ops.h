@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj per family SMU message dispatch */
+/* Do not include this file! */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "nb_smu_ops.h"
+
+/* primary message plus one fallback, e.g. MP1 first and PSMU if MP1 refuses */
+#define SMU_OP_MAX_MSGS 2
+
+struct smu_op_msg {
+	enum SMU_TYPE mailbox;
+	uint32_t id;                     /* 0 terminates the list */
+};
+
+/* resolved per handle slot of one setting */
+struct smu_op {
+	uint32_t count;                  /* 0 if the setting is unsupported on this family */
+	uint32_t scale;                  /* applied to the value before sending */
+	enum SMU_CLASS cls;              /* priority class of the messages */
+	uint32_t unsupported;            /* learned: bit i set if msgs[i] was answered with unknown command */
+	struct smu_op_msg msgs[SMU_OP_MAX_MSGS];
+};
+
+enum ryzen_family;
+void resolve_smu_ops(enum ryzen_family family, struct smu_op *ops);
+const char *smu_op_name(uint32_t setting);
+/* enable style settings without a value */
+int smu_op_is_switch(uint32_t setting);
@@ -0,0 +1,210 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj asynchronous SMU request queue */
+#include <stdlib.h>
+
+#include "ryzenadj.h"
+#include "atomics.h"
+
+/*
+ * Next request to send, called with queue->lock held: the oldest request past the
+ * starvation limit, else the head of the highest class. Classes the mailbox would
+ * hold back for their rate limit are left queued so they can't block urgent work
+ * behind them. Returns NULL and the time to look again in retry_at if nothing is ready.
+ */
+static struct smu_request *pick_request(struct smu_queue *queue, const uint64_t now, uint64_t *retry_at)
+{
+	const uint64_t starvation_ns = smu_starvation_ns(queue->smu);
+	struct smu_request *req;
+	uint64_t ready_at;
+	int cls, best = -1;
+
+	*retry_at = 0;
+	for (cls = 0; cls < CLASS_COUNT; cls++) {
+		req = queue->head[cls];
+		if (!req)
+			continue;
+		ready_at = smu_class_ready_at(queue->smu, cls, now);
+		if (ready_at) {
+			if (!*retry_at || ready_at < *retry_at)
+				*retry_at = ready_at;
+			continue;
+		}
+		if (best < 0)
+			best = cls;
+		else if (now - req->submit_ns > starvation_ns && req->submit_ns < queue->head[best]->submit_ns)
+			best = cls;
+	}
+	if (best < 0)
+		return NULL;
+
+	req = queue->head[best];
+	queue->head[best] = req->next;
+	if (!queue->head[best])
+		queue->tail[best] = NULL;
+	return req;
+}
+
+static int queue_empty(const struct smu_queue *queue)
+{
+	int cls;
+
+	for (cls = 0; cls < CLASS_COUNT; cls++) {
+		if (queue->head[cls])
+			return 0;
+	}
+	return 1;
+}
+
+static OS_THREAD_PROC(smu_queue_worker, arg)
+{
+	struct smu_queue *queue = arg;
+	struct smu_request *req;
+	uint64_t wait_ns, service_ns, now, retry_at, cpu_start_ns;
+
+	os_mutex_lock(&queue->lock);
+	for (;;) {
+		while (queue_empty(queue) && !queue->stop)
+			os_cond_wait(&queue->cond, &queue->lock);
+		if (queue_empty(queue))
+			break;
+
+		now = get_monotonic_time_ns();
+		req = pick_request(queue, now, &retry_at);
+		if (!req) {
+			//everything queued is rate limited, new submissions wake us earlier
+			os_cond_timedwait_ms(&queue->cond, &queue->lock, (uint32_t)((retry_at - now + 999999) / 1000000));
+			continue;
+		}
+		os_mutex_unlock(&queue->lock);
+
+		//the mailbox lock inside serializes us against synchronous callers
+		cpu_start_ns = get_thread_cpu_time_ns();
+		req->start_ns = get_monotonic_time_ns();
+		req->response = smu_service_req(queue->smu, req->cls, req->id, &req->args);
+		req->done_ns = get_monotonic_time_ns();
+		if (queue->smu->ctx)
+			atomic_fetch_add_u64(&queue->smu->ctx->counters.cpu_ns, get_thread_cpu_time_ns() - cpu_start_ns);
+
+		wait_ns = req->start_ns - req->submit_ns;
+		service_ns = req->done_ns - req->start_ns;
+
+		os_mutex_lock(&queue->lock);
+		req->next = NULL;
+		if (queue->done_tail)
+			queue->done_tail->next = req;
+		else
+			queue->done_head = req;
+		queue->done_tail = req;
+
+		queue->depth--;
+		queue->completed++;
+		queue->wait_ns += wait_ns;
+		queue->service_ns += service_ns;
+		if (wait_ns > queue->max_wait_ns)
+			queue->max_wait_ns = wait_ns;
+		if (service_ns > queue->max_service_ns)
+			queue->max_service_ns = service_ns;
+
+		os_wait_obj_wake(queue->wake);
+	}
+	os_mutex_unlock(&queue->lock);
+
+	OS_THREAD_EXIT;
+}
+
+struct smu_queue *smu_queue_start(smu_t smu, os_wait_obj_t *wake)
+{
+	struct smu_queue *queue = calloc(1, sizeof(*queue));
+
+	if (!queue)
+		return NULL;
+
+	queue->smu = smu;
+	queue->wake = wake;
+	os_mutex_init(&queue->lock);
+	os_cond_init(&queue->cond);
+
+	if (os_thread_create(&queue->thread, smu_queue_worker, queue)) {
+		os_cond_destroy(&queue->cond);
+		os_mutex_destroy(&queue->lock);
+		free(queue);
+		return NULL;
+	}
+
+	return queue;
+}
+
+void smu_queue_stop(struct smu_queue *queue)
+{
+	if (!queue || queue->stop)
+		return;
+
+	os_mutex_lock(&queue->lock);
+	queue->stop = 1;
+	os_cond_signal(&queue->cond);
+	os_mutex_unlock(&queue->lock);
+
+	os_thread_join(queue->thread);
+}
+
+void smu_queue_free(struct smu_queue *queue)
+{
+	if (!queue)
+		return;
+
+	smu_queue_stop(queue);
+	os_cond_destroy(&queue->cond);
+	os_mutex_destroy(&queue->lock);
+	free(queue);
+}
+
+void smu_queue_submit(struct smu_queue *queue, struct smu_request *req)
+{
+	req->next = NULL;
+	req->response = 0;
+	req->submit_ns = get_monotonic_time_ns();
+	req->start_ns = 0;
+	req->done_ns = 0;
+
+	os_mutex_lock(&queue->lock);
+	if (queue->tail[req->cls])
+		queue->tail[req->cls]->next = req;
+	else
+		queue->head[req->cls] = req;
+	queue->tail[req->cls] = req;
+
+	queue->submitted++;
+	queue->depth++;
+	if (queue->depth > queue->max_depth)
+		queue->max_depth = queue->depth;
+
+	os_cond_signal(&queue->cond);
+	os_mutex_unlock(&queue->lock);
+}
+
+struct smu_request *smu_queue_take_done(struct smu_queue *queue)
+{
+	struct smu_request *done;
+
+	os_mutex_lock(&queue->lock);
+	done = queue->done_head;
+	queue->done_head = NULL;
+	queue->done_tail = NULL;
+	os_mutex_unlock(&queue->lock);
+
+	return done;
+}
+
+void smu_queue_read_stats(struct smu_queue *queue, struct ryzen_queue_stats *stats)
+{
+	os_mutex_lock(&queue->lock);
+	stats->submitted = queue->submitted;
+	stats->completed = queue->completed;
+	stats->depth = queue->depth;
+	stats->max_depth = queue->max_depth;
+	stats->total_wait_ns = queue->wait_ns;
+	stats->max_wait_ns = queue->max_wait_ns;
+	stats->total_service_ns = queue->service_ns;
+	stats->max_service_ns = queue->max_service_ns;
+	os_mutex_unlock(&queue->lock);
+}
@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj asynchronous SMU request queue */
+/* Do not include this file! */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "nb_smu_ops.h"
+
+struct ryzen_queue_stats;
+
+/* owned by the submitter, usually embedded as first member of a larger request */
+struct smu_request {
+	struct smu_request *next;
+	enum SMU_CLASS cls;
+	uint32_t id;
+	smu_service_args_t args;         /* in: arguments, out: SMU reply */
+	uint32_t response;
+	uint64_t submit_ns;
+	uint64_t start_ns;
+	uint64_t done_ns;
+};
+
+/* one worker thread per mailbox serving classes like the mailbox arbiter, completions are handed back through a wait object */
+struct smu_queue {
+	smu_t smu;
+	os_wait_obj_t *wake;
+	os_thread_t thread;
+	os_mutex_t lock;
+	os_cond_t cond;
+	int stop;
+	struct smu_request *head[CLASS_COUNT];      /* waiting for the worker, per class */
+	struct smu_request *tail[CLASS_COUNT];
+	struct smu_request *done_head, *done_tail;  /* completed, not yet taken */
+	uint32_t depth;                  /* waiting plus in service */
+	uint32_t max_depth;
+	uint64_t submitted;
+	uint64_t completed;
+	uint64_t wait_ns;
+	uint64_t max_wait_ns;
+	uint64_t service_ns;
+	uint64_t max_service_ns;
+};
+
+struct smu_queue *smu_queue_start(smu_t smu, os_wait_obj_t *wake);
+/* sends everything still queued, then joins the worker; completed requests stay to be taken */
+void smu_queue_stop(struct smu_queue *queue);
+void smu_queue_free(struct smu_queue *queue);
+void smu_queue_submit(struct smu_queue *queue, struct smu_request *req);
+/* completed requests in completion order, NULL if none */
+struct smu_request *smu_queue_take_done(struct smu_queue *queue);
+void smu_queue_read_stats(struct smu_queue *queue, struct ryzen_queue_stats *stats);
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj PM table snapshot diff */
+#include <string.h>
+#include <math.h>
+
+#include "ryzenadj.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HAVE_SSE2
+#endif
+
+static int exceeds_threshold(const float old_value, const float new_value,
+			     const float abs_threshold, const float rel_threshold)
+{
+	const float delta = fabsf(new_value - old_value);
+
+	//NaN deltas always count as change
+	if (!(delta == delta))
+		return 1;
+	if (delta <= abs_threshold)
+		return 0;
+	if (delta <= rel_threshold * fabsf(old_value))
+		return 0;
+	return 1;
+}
+
+static size_t check_entry(const float *old_values, const float *new_values, const size_t index,
+			  const float abs_threshold, const float rel_threshold,
+			  struct ryzen_table_diff *changes, const size_t max_changes, size_t found)
+{
+	if (!exceeds_threshold(old_values[index], new_values[index], abs_threshold, rel_threshold))
+		return found;
+
+	if (found < max_changes) {
+		changes[found].offset = (uint32_t)(index * 4);
+		changes[found].old_value = old_values[index];
+		changes[found].new_value = new_values[index];
+	}
+	return found + 1;
+}
+
+EXP size_t CALL diff_table_values(const float *old_values, const float *new_values, size_t table_size,
+				  float abs_threshold, float rel_threshold,
+				  struct ryzen_table_diff *changes, size_t max_changes)
+{
+	const size_t count = table_size / 4;
+	size_t index = 0, found = 0;
+	uint32_t a, b;
+
+	if (!changes)
+		max_changes = 0;
+
+#ifdef HAVE_SSE2
+	//compare raw bits, 4 entries at a time; identical vectors are the common case
+	for (; index + 4 <= count; index += 4) {
+		const __m128i va = _mm_loadu_si128((const __m128i *)(old_values + index));
+		const __m128i vb = _mm_loadu_si128((const __m128i *)(new_values + index));
+		int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va, vb))) ^ 0xF;
+
+		while (mask) {
+			const int lane = mask & 1 ? 0 : mask & 2 ? 1 : mask & 4 ? 2 : 3;
+			found = check_entry(old_values, new_values, index + lane, abs_threshold, rel_threshold,
+					    changes, max_changes, found);
+			mask &= mask - 1;
+		}
+	}
+#endif
+
+	for (; index < count; index++) {
+		memcpy(&a, &old_values[index], sizeof(a));
+		memcpy(&b, &new_values[index], sizeof(b));
+		if (a != b)
+			found = check_entry(old_values, new_values, index, abs_threshold, rel_threshold,
+					    changes, max_changes, found);
+	}
+
+	return found;
+}
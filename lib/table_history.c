@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj PM table history ring */
+#include <stdlib.h>
+#include <string.h>
+
+#include "ryzenadj.h"
+#include "atomics.h"
+
+/*
+ * Single writer (refresh_table), many readers.
+ * Every slot carries the sequence number of the entry it holds. The writer
+ * clears it before touching the payload and publishes it afterwards, so a
+ * reader can detect an entry which got overwritten while it was copying,
+ * without taking any lock.
+ */
+
+struct table_history *table_history_alloc(const uint32_t capacity, const size_t table_size,
+					  const uint32_t *offsets, const uint32_t offset_count)
+{
+	struct table_history *hist;
+	uint32_t i;
+
+	hist = calloc(1, sizeof(*hist));
+	if (!hist)
+		return NULL;
+
+	hist->capacity = capacity;
+	if (offsets && offset_count) {
+		hist->width = offset_count;
+		hist->indices = malloc(offset_count * sizeof(*hist->indices));
+		if (!hist->indices)
+			goto err_exit;
+		for (i = 0; i < offset_count; i++)
+			hist->indices[i] = offsets[i] / 4;
+	} else {
+		hist->width = (uint32_t)(table_size / 4);
+	}
+
+	hist->slots = calloc(capacity, sizeof(*hist->slots));
+	hist->values = calloc((size_t)capacity * hist->width, sizeof(*hist->values));
+	if (!hist->slots || !hist->values)
+		goto err_exit;
+
+	return hist;
+
+err_exit:
+	table_history_free(hist);
+	return NULL;
+}
+
+void table_history_free(struct table_history *hist)
+{
+	if (hist == NULL)
+		return;
+
+	free(hist->indices);
+	free(hist->slots);
+	free(hist->values);
+	free(hist);
+}
+
+void table_history_push(struct table_history *hist, const float *table_values, const uint64_t timestamp_ns)
+{
+	const uint64_t seq = hist->head_seq + 1;
+	struct table_history_slot *slot = &hist->slots[seq % hist->capacity];
+	float *dst = &hist->values[(seq % hist->capacity) * hist->width];
+	uint32_t i;
+
+	atomic_store_release_u64(&slot->seq, 0);
+	atomic_fence_release();
+
+	slot->timestamp_ns = timestamp_ns;
+	if (hist->indices) {
+		for (i = 0; i < hist->width; i++)
+			dst[i] = table_values[hist->indices[i]];
+	} else {
+		memcpy(dst, table_values, hist->width * sizeof(*dst));
+	}
+
+	atomic_store_release_u64(&slot->seq, seq);
+	atomic_store_release_u64(&hist->head_seq, seq);
+}
+
+static int read_slot_timestamp(const struct table_history *hist, const uint64_t seq, uint64_t *timestamp_ns)
+{
+	const struct table_history_slot *slot = &hist->slots[seq % hist->capacity];
+
+	if (atomic_load_acquire_u64((volatile uint64_t *)&slot->seq) != seq)
+		return ADJ_ERR_NOT_AVAILABLE;
+	*timestamp_ns = slot->timestamp_ns;
+	atomic_fence_acquire();
+	if (atomic_load_acquire_u64((volatile uint64_t *)&slot->seq) != seq)
+		return ADJ_ERR_NOT_AVAILABLE;
+
+	return 0;
+}
+
+int table_history_read(const struct table_history *hist, const uint64_t seq, float *values, uint64_t *timestamp_ns)
+{
+	const struct table_history_slot *slot;
+	uint64_t ts;
+
+	if (seq == 0)
+		return ADJ_ERR_NOT_AVAILABLE;
+
+	slot = &hist->slots[seq % hist->capacity];
+	if (atomic_load_acquire_u64((volatile uint64_t *)&slot->seq) != seq)
+		return ADJ_ERR_NOT_AVAILABLE;
+
+	ts = slot->timestamp_ns;
+	if (values)
+		memcpy(values, &hist->values[(seq % hist->capacity) * hist->width], hist->width * sizeof(*values));
+
+	atomic_fence_acquire();
+	if (atomic_load_acquire_u64((volatile uint64_t *)&slot->seq) != seq)
+		return ADJ_ERR_NOT_AVAILABLE;
+
+	if (timestamp_ns)
+		*timestamp_ns = ts;
+	return 0;
+}
+
+uint64_t table_history_find(const struct table_history *hist, const uint64_t timestamp_ns)
+{
+	uint64_t newest, oldest, lo, hi, mid, ts;
+
+	newest = atomic_load_acquire_u64((volatile uint64_t *)&hist->head_seq);
+	if (newest == 0)
+		return 0;
+
+	//skip the oldest slot, it is the next one the writer is going to reuse
+	oldest = newest >= hist->capacity ? newest - hist->capacity + 2 : 1;
+	if (oldest > newest)
+		oldest = newest;
+
+	if (read_slot_timestamp(hist, oldest, &ts) || ts > timestamp_ns)
+		return 0;
+
+	//binary search for the newest entry not younger than timestamp_ns
+	lo = oldest;
+	hi = newest;
+	while (lo < hi) {
+		mid = lo + (hi - lo + 1) / 2;
+		if (read_slot_timestamp(hist, mid, &ts))
+			return 0;
+		if (ts <= timestamp_ns)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	return lo;
+}
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj PM table history ring */
+/* Do not include this file! */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct table_history_slot {
+	volatile uint64_t seq;           /* 0 while the slot is being written */
+	uint64_t timestamp_ns;
+};
+
+struct table_history {
+	uint32_t capacity;
+	uint32_t width;                  /* floats per entry */
+	uint32_t *indices;               /* table index per field, NULL for the full table */
+	struct table_history_slot *slots;
+	float *values;                   /* capacity * width */
+	volatile uint64_t head_seq;      /* newest complete entry, 0 if empty */
+};
+
+struct table_history *table_history_alloc(uint32_t capacity, size_t table_size,
+					  const uint32_t *offsets, uint32_t offset_count);
+void table_history_free(struct table_history *hist);
+void table_history_push(struct table_history *hist, const float *table_values, uint64_t timestamp_ns);
+int table_history_read(const struct table_history *hist, uint64_t seq, float *values, uint64_t *timestamp_ns);
+uint64_t table_history_find(const struct table_history *hist, uint64_t timestamp_ns);
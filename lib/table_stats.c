@@ -0,0 +1,256 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj windowed PM table statistics */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "ryzenadj.h"
+
+/*
+ * Aggregates are kept as columns (one array per statistic, indexed by field)
+ * so every refresh is a handful of straight loops over float arrays which the
+ * compiler can vectorize. Quantiles come from a log scale histogram per field
+ * with 4 bins per power of two, interpolated inside the bin and clamped to
+ * the exact min/max of the window.
+ */
+
+static uint16_t stats_bin(const float v)
+{
+	uint32_t bits;
+	int exp, mag;
+
+	memcpy(&bits, &v, sizeof(bits));
+	exp = (int)((bits >> 23) & 0xFF) - 127;
+	mag = (int)((bits >> 21) & (STATS_SUB_BINS - 1));
+
+	if (exp < STATS_EXP_MIN)
+		return STATS_HALF_BINS;
+	if (exp >= STATS_EXP_MIN + STATS_EXP_COUNT) {
+		exp = STATS_EXP_MIN + STATS_EXP_COUNT - 1;
+		mag = STATS_SUB_BINS - 1;
+	}
+
+	mag += (exp - STATS_EXP_MIN) * STATS_SUB_BINS;
+	return (uint16_t)(bits >> 31 ? STATS_HALF_BINS - 1 - mag : STATS_HALF_BINS + 1 + mag);
+}
+
+/* value range [lo, hi) covered by a histogram bin */
+static void stats_bin_range(const int bin, float *lo, float *hi)
+{
+	const int mag = bin > STATS_HALF_BINS ? bin - STATS_HALF_BINS - 1 : STATS_HALF_BINS - 1 - bin;
+	const float base = ldexpf(1.0f, mag / STATS_SUB_BINS + STATS_EXP_MIN);
+	const float step = base / STATS_SUB_BINS;
+
+	if (bin == STATS_HALF_BINS) {
+		*lo = *hi = 0;
+	} else if (bin > STATS_HALF_BINS) {
+		*lo = base + step * (mag % STATS_SUB_BINS);
+		*hi = *lo + step;
+	} else {
+		*hi = -(base + step * (mag % STATS_SUB_BINS));
+		*lo = *hi - step;
+	}
+}
+
+struct table_stats *table_stats_alloc(const size_t table_size, const uint32_t *offsets, const uint32_t offset_count,
+				      const uint64_t *window_ns, const uint32_t window_count)
+{
+	struct table_stats *stats;
+	struct stats_bucket *b;
+	uint32_t i, w, k;
+
+	stats = calloc(1, sizeof(*stats));
+	if (!stats)
+		return NULL;
+
+	stats->table_fields = (uint32_t)(table_size / 4);
+	stats->field_of_index = malloc(stats->table_fields * sizeof(*stats->field_of_index));
+	if (!stats->field_of_index)
+		goto err_exit;
+
+	if (offsets && offset_count) {
+		stats->fields = offset_count;
+		stats->indices = malloc(offset_count * sizeof(*stats->indices));
+		stats->gather = malloc(offset_count * sizeof(*stats->gather));
+		if (!stats->indices || !stats->gather)
+			goto err_exit;
+		for (i = 0; i < table_size / 4; i++)
+			stats->field_of_index[i] = -1;
+		for (i = 0; i < offset_count; i++) {
+			stats->indices[i] = offsets[i] / 4;
+			stats->field_of_index[offsets[i] / 4] = i;
+		}
+	} else {
+		stats->fields = (uint32_t)(table_size / 4);
+		for (i = 0; i < stats->fields; i++)
+			stats->field_of_index[i] = i;
+	}
+
+	stats->bins = malloc(stats->fields * sizeof(*stats->bins));
+	stats->windows = calloc(window_count, sizeof(*stats->windows));
+	if (!stats->bins || !stats->windows)
+		goto err_exit;
+	stats->window_count = window_count;
+
+	for (w = 0; w < window_count; w++) {
+		stats->windows[w].bucket_ns = window_ns[w] / STATS_BUCKETS;
+		for (k = 0; k < STATS_BUCKETS; k++) {
+			b = &stats->windows[w].buckets[k];
+			b->min = malloc(stats->fields * sizeof(*b->min));
+			b->max = malloc(stats->fields * sizeof(*b->max));
+			b->sum = malloc(stats->fields * sizeof(*b->sum));
+			b->hist = malloc((size_t)stats->fields * STATS_BINS * sizeof(*b->hist));
+			if (!b->min || !b->max || !b->sum || !b->hist)
+				goto err_exit;
+		}
+	}
+
+	return stats;
+
+err_exit:
+	table_stats_free(stats);
+	return NULL;
+}
+
+void table_stats_free(struct table_stats *stats)
+{
+	uint32_t w, k;
+
+	if (stats == NULL)
+		return;
+
+	for (w = 0; stats->windows && w < stats->window_count; w++) {
+		for (k = 0; k < STATS_BUCKETS; k++) {
+			free(stats->windows[w].buckets[k].min);
+			free(stats->windows[w].buckets[k].max);
+			free(stats->windows[w].buckets[k].sum);
+			free(stats->windows[w].buckets[k].hist);
+		}
+	}
+	free(stats->windows);
+	free(stats->bins);
+	free(stats->gather);
+	free(stats->indices);
+	free(stats->field_of_index);
+	free(stats);
+}
+
+static void update_bucket(struct stats_bucket *b, const float *cur, const uint16_t *bins,
+			  const uint32_t fields)
+{
+	float *mn = b->min, *mx = b->max;
+	double *sum = b->sum;
+	uint32_t i;
+
+	if (!b->count) {
+		memcpy(mn, cur, fields * sizeof(*mn));
+		memcpy(mx, cur, fields * sizeof(*mx));
+		for (i = 0; i < fields; i++)
+			sum[i] = cur[i];
+	} else {
+		for (i = 0; i < fields; i++)
+			mn[i] = cur[i] < mn[i] ? cur[i] : mn[i];
+		for (i = 0; i < fields; i++)
+			mx[i] = cur[i] > mx[i] ? cur[i] : mx[i];
+		for (i = 0; i < fields; i++)
+			sum[i] += cur[i];
+	}
+
+	for (i = 0; i < fields; i++)
+		b->hist[(size_t)i * STATS_BINS + bins[i]]++;
+	b->count++;
+}
+
+void table_stats_update(struct table_stats *stats, const float *table_values, const uint64_t timestamp_ns)
+{
+	const float *cur = table_values;
+	struct stats_bucket *b;
+	uint64_t epoch;
+	uint32_t i, w;
+
+	if (stats->indices) {
+		for (i = 0; i < stats->fields; i++)
+			stats->gather[i] = table_values[stats->indices[i]];
+		cur = stats->gather;
+	}
+
+	for (i = 0; i < stats->fields; i++)
+		stats->bins[i] = stats_bin(cur[i]);
+
+	for (w = 0; w < stats->window_count; w++) {
+		epoch = timestamp_ns / stats->windows[w].bucket_ns;
+		b = &stats->windows[w].buckets[epoch % STATS_BUCKETS];
+		if (b->epoch != epoch || !b->count) {
+			b->epoch = epoch;
+			b->count = 0;
+			memset(b->hist, 0, (size_t)stats->fields * STATS_BINS * sizeof(*b->hist));
+		}
+		update_bucket(b, cur, stats->bins, stats->fields);
+	}
+}
+
+static float quantile(const uint32_t *hist, const uint32_t count, const float q, const float mn, const float mx)
+{
+	const double rank = q * (count - 1);
+	uint32_t cum = 0;
+	float lo, hi, v = mx;
+	int bin;
+
+	for (bin = 0; bin < STATS_BINS; bin++) {
+		if (!hist[bin])
+			continue;
+		if (cum + hist[bin] > rank) {
+			stats_bin_range(bin, &lo, &hi);
+			v = lo + (hi - lo) * (float)((rank - cum + 0.5) / hist[bin]);
+			break;
+		}
+		cum += hist[bin];
+	}
+
+	return v < mn ? mn : v > mx ? mx : v;
+}
+
+int table_stats_read(const struct table_stats *stats, const uint32_t offset, const uint32_t window, const uint64_t now_ns,
+		     struct ryzen_field_stats *out)
+{
+	const struct stats_window *win;
+	const struct stats_bucket *b;
+	uint32_t hist[STATS_BINS];
+	uint64_t epoch;
+	double sum = 0;
+	int32_t field;
+	uint32_t k, bin;
+
+	if (window >= stats->window_count || offset % 4 || offset / 4 >= stats->table_fields)
+		return ADJ_ERR_INVALID_ARG;
+	field = stats->field_of_index[offset / 4];
+	if (field < 0)
+		return ADJ_ERR_INVALID_ARG;
+
+	win = &stats->windows[window];
+	epoch = now_ns / win->bucket_ns;
+	memset(out, 0, sizeof(*out));
+	memset(hist, 0, sizeof(hist));
+
+	for (k = 0; k < STATS_BUCKETS; k++) {
+		b = &win->buckets[k];
+		if (!b->count || b->epoch > epoch || b->epoch + STATS_BUCKETS <= epoch)
+			continue;
+		if (!out->count || b->min[field] < out->min)
+			out->min = b->min[field];
+		if (!out->count || b->max[field] > out->max)
+			out->max = b->max[field];
+		sum += b->sum[field];
+		out->count += b->count;
+		for (bin = 0; bin < STATS_BINS; bin++)
+			hist[bin] += b->hist[(size_t)field * STATS_BINS + bin];
+	}
+
+	if (!out->count)
+		return ADJ_ERR_NOT_AVAILABLE;
+
+	out->mean = (float)(sum / out->count);
+	out->p50 = quantile(hist, out->count, 0.5f, out->min, out->max);
+	out->p99 = quantile(hist, out->count, 0.99f, out->min, out->max);
+	return 0;
+}
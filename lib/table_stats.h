@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj windowed PM table statistics */
+/* Do not include this file! */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* every window is split into STATS_BUCKETS sub-buckets, the oldest one gets recycled */
+#define STATS_BUCKETS      4
+/* log scale histogram: sign, 20 binary exponents (2^-4 .. 2^15) with 4 sub-bins each, zero bin */
+#define STATS_EXP_MIN      (-4)
+#define STATS_EXP_COUNT    20
+#define STATS_SUB_BINS     4
+#define STATS_HALF_BINS    (STATS_EXP_COUNT * STATS_SUB_BINS)
+#define STATS_BINS         (2 * STATS_HALF_BINS + 1)
+
+struct stats_bucket {
+	uint64_t epoch;                  /* timestamp / bucket length of the data inside */
+	uint32_t count;                  /* samples, the same for every field */
+	float *min;
+	float *max;
+	double *sum;
+	uint32_t *hist;                  /* fields * STATS_BINS, as wide as count so it never wraps first */
+};
+
+struct stats_window {
+	uint64_t bucket_ns;
+	struct stats_bucket buckets[STATS_BUCKETS];
+};
+
+struct table_stats {
+	uint32_t fields;
+	uint32_t *indices;               /* table index per field, NULL for the full table */
+	int32_t *field_of_index;         /* reverse lookup, table index -> field */
+	uint32_t table_fields;           /* entries of field_of_index, table_size / 4 */
+	float *gather;                   /* selected values of the current refresh */
+	uint16_t *bins;                  /* histogram bin of the current refresh per field */
+	struct stats_window *windows;
+	uint32_t window_count;
+};
+
+struct table_stats *table_stats_alloc(size_t table_size, const uint32_t *offsets, uint32_t offset_count,
+				      const uint64_t *window_ns, uint32_t window_count);
+void table_stats_free(struct table_stats *stats);
+void table_stats_update(struct table_stats *stats, const float *table_values, uint64_t timestamp_ns);
+
+struct ryzen_field_stats;
+int table_stats_read(const struct table_stats *stats, uint32_t offset, uint32_t window, uint64_t now_ns,
+		     struct ryzen_field_stats *out);
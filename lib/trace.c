@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj binary trace ring */
+#include <stdlib.h>
+
+#include "ryzenadj.h"
+#include "atomics.h"
+
+#ifdef _WIN32
+#define trace_getpid() GetCurrentProcessId()
+#else
+#define trace_getpid() getpid()
+#endif
+
+/*
+ * Many writers (API callers and queue workers), one exporter. Writers claim a
+ * slot with an atomic add on head and publish it with its sequence number like
+ * the table history does, the exporter skips slots torn by a concurrent writer.
+ * Recording is a fixed size copy, formatting happens only on export.
+ */
+
+struct trace_ring *trace_ring_alloc(uint32_t capacity)
+{
+	struct trace_ring *ring;
+	uint32_t size = 1;
+
+	while (size < capacity && size < (1u << 31))
+		size <<= 1;
+
+	ring = calloc(1, sizeof(*ring));
+	if (!ring)
+		return NULL;
+
+	ring->mask = size - 1;
+	ring->events = calloc(size, sizeof(*ring->events));
+	if (!ring->events) {
+		free(ring);
+		return NULL;
+	}
+
+	return ring;
+}
+
+void trace_ring_free(struct trace_ring *ring)
+{
+	if (ring == NULL)
+		return;
+
+	free(ring->events);
+	free(ring);
+}
+
+void trace_record(struct trace_ring *ring, const enum trace_type type, const uint64_t start_ns, const uint64_t dur_ns,
+		  const uint32_t mailbox, const uint32_t cls, const uint32_t id, const uint32_t arg0,
+		  const uint32_t response, const uint64_t wait_ns)
+{
+	const uint64_t seq = atomic_fetch_add_u64(&ring->head, 1) + 1;
+	struct trace_event *ev = &ring->events[(seq - 1) & ring->mask];
+
+	atomic_store_release_u64(&ev->seq, 0);
+	atomic_fence_release();
+	ev->start_ns = start_ns;
+	ev->dur_ns = dur_ns;
+	ev->wait_ns = wait_ns > UINT32_MAX ? UINT32_MAX : (uint32_t)wait_ns;
+	ev->type = (uint16_t)type;
+	ev->mailbox = (uint8_t)mailbox;
+	ev->cls = (uint8_t)cls;
+	ev->tid = os_thread_id();
+	ev->id = id;
+	ev->arg0 = arg0;
+	ev->response = response;
+	atomic_store_release_u64(&ev->seq, seq);
+}
+
+static const char *const mailbox_names[] = { "MP1", "PSMU" };
+static const char *const class_names[] = { "critical", "control", "telemetry" };
+
+static void write_event(const struct trace_event *ev, const unsigned long pid, FILE *f)
+{
+	const double ts = ev->start_ns / 1000.0;
+	const double dur = ev->dur_ns / 1000.0;
+	const char *mailbox = ev->mailbox < TYPE_COUNT ? mailbox_names[ev->mailbox] : "?";
+
+	switch (ev->type) {
+	case TRACE_SMU_REQ:
+		fprintf(f, "{\"name\":\"%s 0x%x\",\"cat\":\"smu\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+			"\"pid\":%lu,\"tid\":%u,\"args\":{\"mailbox\":\"%s\",\"msg\":\"0x%x\",\"arg0\":%u,"
+			"\"response\":\"0x%x\",\"class\":\"%s\",\"wait_us\":%.3f}}",
+			mailbox, ev->id, ts, dur, pid, ev->tid, mailbox, ev->id, ev->arg0, ev->response,
+			ev->cls < CLASS_COUNT ? class_names[ev->cls] : "?", ev->wait_ns / 1000.0);
+		break;
+	case TRACE_TRANSFER:
+		fprintf(f, "{\"name\":\"transfer_table\",\"cat\":\"table\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+			"\"pid\":%lu,\"tid\":%u,\"args\":{\"response\":\"0x%x\"}}",
+			ts, dur, pid, ev->tid, ev->response);
+		break;
+	case TRACE_COPY:
+		fprintf(f, "{\"name\":\"copy_pm_table\",\"cat\":\"table\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+			"\"pid\":%lu,\"tid\":%u,\"args\":{\"bytes\":%u,\"result\":%d}}",
+			ts, dur, pid, ev->tid, ev->id, (int)ev->response);
+		break;
+	case TRACE_RETRY:
+		if (ev->id == TRACE_RETRY_TRANSFER)
+			fprintf(f, "{\"name\":\"retry transfer_table\",\"cat\":\"retry\",\"ph\":\"i\",\"s\":\"t\","
+				"\"ts\":%.3f,\"pid\":%lu,\"tid\":%u,\"args\":{\"attempt\":%u,\"delay_ms\":%u}}",
+				ts, pid, ev->tid, ev->arg0, ev->response);
+		else
+			fprintf(f, "{\"name\":\"retry set_%s\",\"cat\":\"retry\",\"ph\":\"i\",\"s\":\"t\","
+				"\"ts\":%.3f,\"pid\":%lu,\"tid\":%u,\"args\":{\"mailbox\":\"%s\"}}",
+				smu_op_name(ev->id), ts, pid, ev->tid, mailbox);
+		break;
+	}
+}
+
+int trace_write_json(const struct trace_ring *ring, FILE *f)
+{
+	const unsigned long pid = (unsigned long)trace_getpid();
+	const uint64_t head = atomic_load_acquire_u64((volatile uint64_t *)&ring->head);
+	const uint64_t capacity = (uint64_t)ring->mask + 1;
+	struct trace_event ev;
+	uint64_t seq;
+	int first = 1;
+
+	fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	for (seq = head > capacity ? head - capacity + 1 : 1; seq <= head; seq++) {
+		const struct trace_event *slot = &ring->events[(seq - 1) & ring->mask];
+
+		if (atomic_load_acquire_u64((volatile uint64_t *)&slot->seq) != seq)
+			continue;
+		ev = *slot;
+		atomic_fence_acquire();
+		if (atomic_load_acquire_u64((volatile uint64_t *)&slot->seq) != seq)
+			continue;
+
+		if (!first)
+			fprintf(f, ",\n");
+		write_event(&ev, pid, f);
+		first = 0;
+	}
+	fprintf(f, "\n]}\n");
+
+	return ferror(f) ? ADJ_ERR_MEMORY_ACCESS : 0;
+}
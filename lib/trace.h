@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj binary trace ring */
+/* Do not include this file! */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+enum trace_type {
+	TRACE_SMU_REQ,                   /* mailbox, class, message id, arg0, response */
+	TRACE_TRANSFER,                  /* one transfer table attempt, response */
+	TRACE_COPY,                      /* PM table copy, size in id */
+	TRACE_RETRY,                     /* instant: transfer table (id ~0) or setting fallback to mailbox */
+};
+
+#define TRACE_RETRY_TRANSFER         0xFFFFFFFFu
+
+struct trace_event {
+	volatile uint64_t seq;           /* 0 while the slot is being written */
+	uint64_t start_ns;
+	uint64_t dur_ns;
+	uint32_t wait_ns;                /* SMU requests: time spent waiting for the mailbox */
+	uint16_t type;
+	uint8_t mailbox;
+	uint8_t cls;
+	uint32_t tid;
+	uint32_t id;
+	uint32_t arg0;
+	uint32_t response;
+};
+
+struct trace_ring {
+	uint32_t mask;                   /* capacity - 1, capacity is a power of two */
+	volatile uint64_t head;          /* events ever claimed */
+	struct trace_event *events;
+};
+
+struct trace_ring *trace_ring_alloc(uint32_t capacity);
+void trace_ring_free(struct trace_ring *ring);
+/* lock free, any thread */
+void trace_record(struct trace_ring *ring, enum trace_type type, uint64_t start_ns, uint64_t dur_ns,
+		  uint32_t mailbox, uint32_t cls, uint32_t id, uint32_t arg0, uint32_t response, uint64_t wait_ns);
+/* Chrome trace event format, timestamps are get_monotonic_time_ns in microseconds */
+int trace_write_json(const struct trace_ring *ring, FILE *f);
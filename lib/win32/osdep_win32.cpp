@@ -127,6 +127,120 @@ bool is_using_smu_driver() {
     return false;
 }
 
+uint64_t get_monotonic_time_ns() {
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    if (!frequency.QuadPart)
+        QueryPerformanceFrequency(&frequency);
+
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000ull +
+           (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000ull / frequency.QuadPart;
+}
+
+uint64_t get_thread_cpu_time_ns() {
+    FILETIME creation, exit, kernel, user;
+    ULARGE_INTEGER k, u;
+
+    //100 ns units, but only updated every scheduler tick
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+        return 0;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) * 100;
+}
+
+void get_syscall_cost(const os_access_obj_t *obj, struct os_syscall_cost *cost) {
+    //WinRing0 issues one driver IOCTL per config space access, PM table is mapped
+    cost->smn_read = 2;
+    cost->smn_write = 2;
+    cost->pm_table_copy = 0;
+}
+
+int get_boot_id(char *buf, size_t size) {
+    FILETIME now;
+    ULARGE_INTEGER t;
+
+    //no boot id on Windows, use the boot time rounded to 10 seconds
+    GetSystemTimeAsFileTime(&now);
+    t.LowPart = now.dwLowDateTime;
+    t.HighPart = now.dwHighDateTime;
+    t.QuadPart = t.QuadPart / 10000000ull - GetTickCount64() / 1000ull;
+    snprintf(buf, size, "boot-%llu", (unsigned long long)(t.QuadPart / 10));
+    return 0;
+}
+
+//manual reset event, a timer queue timer sets it when the armed deadline passes
+struct _os_wait_obj {
+    HANDLE event;
+    HANDLE timer;
+};
+
+os_wait_obj_t *os_wait_obj_init() {
+    os_wait_obj_t *obj = (os_wait_obj_t *)calloc(1, sizeof(*obj));
+
+    if (obj == NULL)
+        return NULL;
+
+    obj->event = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (obj->event == NULL) {
+        free(obj);
+        return NULL;
+    }
+
+    return obj;
+}
+
+intptr_t os_wait_obj_get_fd(const os_wait_obj_t *obj) {
+    return (intptr_t)obj->event;
+}
+
+static VOID CALLBACK os_wait_obj_timer(PVOID event, BOOLEAN fired) {
+    SetEvent((HANDLE)event);
+}
+
+void os_wait_obj_arm(os_wait_obj_t *obj, uint64_t deadline_ns) {
+    const uint64_t now = get_monotonic_time_ns();
+
+    //don't wait for a running callback, a late SetEvent is only a spurious wakeup
+    if (obj->timer) {
+        DeleteTimerQueueTimer(NULL, obj->timer, NULL);
+        obj->timer = NULL;
+    }
+    if (!deadline_ns)
+        return;
+
+    if (deadline_ns <= now) {
+        SetEvent(obj->event);
+        return;
+    }
+
+    CreateTimerQueueTimer(&obj->timer, NULL, os_wait_obj_timer, obj->event,
+                          (DWORD)((deadline_ns - now + 999999) / 1000000), 0, WT_EXECUTEONLYONCE);
+}
+
+void os_wait_obj_wake(os_wait_obj_t *obj) {
+    SetEvent(obj->event);
+}
+
+void os_wait_obj_clear(os_wait_obj_t *obj) {
+    ResetEvent(obj->event);
+}
+
+void os_wait_obj_free(os_wait_obj_t *obj) {
+    if (obj == NULL)
+        return;
+
+    //wait for a running callback, it still references the event
+    if (obj->timer)
+        DeleteTimerQueueTimer(NULL, obj->timer, INVALID_HANDLE_VALUE);
+    CloseHandle(obj->event);
+    free(obj);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: GPL-2.0
+/* ryzenadj event loop of the long running modes */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <poll.h>
+#endif
+
+#include "loop.h"
+
+volatile sig_atomic_t loop_stop;
+
+static void stop_loop(int sig)
+{
+	loop_stop = 1;
+}
+
+static void wait_for_work(const intptr_t fd, const uint32_t timeout_ms)
+{
+#ifdef _WIN32
+	if (fd >= 0)
+		WaitForSingleObject((HANDLE)fd, timeout_ms == UINT32_MAX ? INFINITE : timeout_ms);
+	else
+		Sleep(timeout_ms);
+#else
+	struct pollfd pfd = { (int)fd, POLLIN, 0 };
+
+	//signals interrupt poll, the loop then sees loop_stop
+	poll(&pfd, fd >= 0 ? 1 : 0, timeout_ms == UINT32_MAX ? -1 : (int)timeout_ms);
+#endif
+}
+
+void run_loop(ryzen_access ry)
+{
+	const intptr_t fd = ryzenadj_get_fd(ry);
+	uint32_t timeout_ms;
+
+	loop_stop = 0;
+	signal(SIGINT, stop_loop);
+	signal(SIGTERM, stop_loop);
+
+	while (!loop_stop) {
+		ryzenadj_dispatch(ry, &timeout_ms);
+		if (!loop_stop)
+			wait_for_work(fd, timeout_ms);
+	}
+
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+}
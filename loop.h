@@ -0,0 +1,14 @@
+// SPDX-License-Identifier: GPL-2.0
+/* ryzenadj event loop of the long running modes */
+
+#pragma once
+
+#include <signal.h>
+
+#include "lib/ryzenadj.h"
+
+/* set by SIGINT/SIGTERM while run_loop is active, callbacks may set it to end the loop */
+extern volatile sig_atomic_t loop_stop;
+
+/* dispatch the handle until loop_stop, sleeping on its fd in between */
+void run_loop(ryzen_access ry);
@@ -4,65 +4,200 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
 
 #include "lib/ryzenadj.h"
 #include "argparse.h"
+#include "monitor.h"
+#include "hold.h"
+#include "session.h"
+#include "batch.h"
 
 #define STRINGIFY2(X) #X
 #define STRINGIFY(X) STRINGIFY2(X)
 
+//time the PM table gets to show the settings of --atomic
+#define ATOMIC_VERIFY_MS 1000
+
 #define _do_adjust(ARG) \
 do {                                                                              \
 	/* ignore max unsigned integer values */                                      \
-	if (ARG != -1) {                                                              \
-		int adjerr = set_##ARG(ry, ARG);                                          \
-		if (!adjerr){                                                             \
-			any_adjust_applied = 1;                                               \
-			printf("Successfully set " STRINGIFY(ARG) " to %u\n", ARG);            \
-		} else if (adjerr == ADJ_ERR_FAM_UNSUPPORTED) {                           \
-			printf("set_" STRINGIFY(ARG) " is not supported on this family\n");   \
-			err = -1;                                                             \
-		} else if (adjerr == ADJ_ERR_SMU_UNSUPPORTED) {                           \
-			printf("set_" STRINGIFY(ARG) " is not supported on this SMU\n");      \
-			err = -1;                                                             \
-		} else if (adjerr == ADJ_ERR_SMU_REJECTED) {                              \
-			printf("set_" STRINGIFY(ARG) " is rejected by SMU\n");                \
-			err = -1;                                                             \
-		} else {                                                                  \
-			printf("Failed to set" STRINGIFY(ARG) " \n");                         \
-			err = -1;                                                             \
-		}                                                                         \
-	}                                                                             \
+	if (ARG != -1)                                                                \
+		set_by_name(requested, STRINGIFY(ARG), ARG);                              \
 } while(0);
 
 #define _do_enable(ARG) \
 do {                                                                              \
-	if (ARG) {                                                                    \
-		int adjerr = set_##ARG(ry);                                               \
-		if (!adjerr){                                                             \
-			any_adjust_applied = 1;                                               \
-			printf("Successfully enable " STRINGIFY(ARG) "\n");                    \
-		} else if (adjerr == ADJ_ERR_FAM_UNSUPPORTED) {                           \
-			printf("set_" STRINGIFY(ARG) " is not supported on this family\n");   \
-			err = -1;                                                             \
-		} else if (adjerr == ADJ_ERR_SMU_UNSUPPORTED) {                           \
-			printf("set_" STRINGIFY(ARG) " is not supported on this SMU\n");      \
-			err = -1;                                                             \
-		} else if (adjerr == ADJ_ERR_SMU_REJECTED) {                              \
-			printf("set_" STRINGIFY(ARG) " is rejected by SMU\n");                \
-			err = -1;                                                             \
-		} else {                                                                  \
-			printf("Failed to set" STRINGIFY(ARG) " \n");                         \
-			err = -1;                                                             \
-		}                                                                         \
-	}                                                                             \
+	if (ARG)                                                                      \
+		set_by_name(requested, STRINGIFY(ARG), 0);                                \
 } while(0);
 
 static const char *const usage[] = {
 	"ryzenadj [options]",
+	"ryzenadj [options] --session -- <command> [args...]",
 	NULL,
 };
 
+static void set_by_name(uint32_t *values, const char *name, uint32_t value)
+{
+	const int setting = find_setting_by_name(name);
+
+	if (setting >= 0)
+		values[setting] = value;
+}
+
+//the PM table limit already is the requested value, get_setting_limit reports the units of set_setting
+static int limit_unchanged(ryzen_access ry, enum ryzen_setting setting, uint32_t value)
+{
+	const float limit = get_setting_limit(ry, setting);
+
+	return !isnan(limit) && fabsf(limit - value) <= ADJ_LIMIT_TOLERANCE;
+}
+
+static int count_requested(const uint32_t *requested)
+{
+	int setting, count = 0;
+
+	for (setting = 0; setting < ADJ_SETTING_COUNT; setting++)
+		count += requested[setting] != UINT32_MAX;
+
+	return count;
+}
+
+static void apply_requested(ryzen_access ry, const uint32_t *requested, int skip_unchanged, uint32_t *applied,
+			    int *any_adjust_applied, int *err)
+{
+	enum ryzen_setting order[ADJ_SETTING_COUNT];
+	enum ryzen_setting setting;
+	uint32_t count, i, value;
+	const char *name;
+	int adjerr;
+
+	//dependent limits are sent in an order that keeps them valid at every step
+	if (plan_settings(ry, requested, order, &count))
+		printf("Warning: requested limits contradict each other, the SMU may reject or clamp them\n");
+
+	for (i = 0; i < count; i++) {
+		setting = order[i];
+		value = requested[setting];
+		name = get_setting_name(setting);
+		if (skip_unchanged && !is_setting_switch(setting) && limit_unchanged(ry, setting, value)) {
+			applied[setting] = value;
+			printf("Skipped %s, already %u\n", name, value);
+			continue;
+		}
+
+		adjerr = set_setting(ry, setting, value);
+		if (!adjerr) {
+			*any_adjust_applied = 1;
+			applied[setting] = value;
+			if (is_setting_switch(setting))
+				printf("Successfully enable %s\n", name);
+			else
+				printf("Successfully set %s to %u\n", name, value);
+		} else if (adjerr == ADJ_ERR_FAM_UNSUPPORTED) {
+			printf("set_%s is not supported on this family\n", name);
+			*err = -1;
+		} else if (adjerr == ADJ_ERR_SMU_UNSUPPORTED) {
+			printf("set_%s is not supported on this SMU\n", name);
+			*err = -1;
+		} else if (adjerr == ADJ_ERR_SMU_REJECTED) {
+			printf("set_%s is rejected by SMU\n", name);
+			*err = -1;
+		} else {
+			printf("Failed to set%s \n", name);
+			*err = -1;
+		}
+	}
+}
+
+static void apply_profile_file(ryzen_access ry, const char *path, const char *section, uint32_t *applied,
+			       int *any_adjust_applied, int *err)
+{
+	uint32_t values[ADJ_SETTING_COUNT];
+	ryzen_profile profile;
+	int setting, adjerr;
+
+	profile = load_profile(ry, path, section, &adjerr);
+	if (!profile) {
+		printf("Unable to load profile %s: %d\n", path, adjerr);
+		*err = -1;
+		return;
+	}
+
+	adjerr = apply_profile(ry, profile);
+	get_profile_values(profile, values);
+	free_profile(profile);
+	if (adjerr) {
+		printf("Failed to apply profile %s: %d\n", path, adjerr);
+		*err = -1;
+		return;
+	}
+
+	for (setting = 0; setting < ADJ_SETTING_COUNT; setting++) {
+		if (values[setting] == UINT32_MAX)
+			continue;
+		applied[setting] = values[setting];
+		printf("Successfully set %s to %u\n", get_setting_name(setting), values[setting]);
+	}
+	*any_adjust_applied = 1;
+}
+
+//settings of the profile the command line doesn't set itself
+static int merge_profile(ryzen_access ry, const char *path, const char *section, uint32_t *requested)
+{
+	uint32_t values[ADJ_SETTING_COUNT];
+	ryzen_profile profile;
+	int setting, adjerr;
+
+	profile = load_profile(ry, path, section, &adjerr);
+	if (!profile) {
+		printf("Unable to load profile %s: %d\n", path, adjerr);
+		return -1;
+	}
+	get_profile_values(profile, values);
+	free_profile(profile);
+
+	for (setting = 0; setting < ADJ_SETTING_COUNT; setting++) {
+		if (requested[setting] == UINT32_MAX)
+			requested[setting] = values[setting];
+	}
+	return 0;
+}
+
+static void apply_atomic(ryzen_access ry, uint32_t *requested, int skip_unchanged, uint32_t *applied,
+			 int *any_adjust_applied, int *err)
+{
+	int setting, failed, adjerr;
+
+	for (setting = 0; setting < ADJ_SETTING_COUNT; setting++) {
+		if (requested[setting] == UINT32_MAX || !skip_unchanged || is_setting_switch(setting) ||
+		    !limit_unchanged(ry, setting, requested[setting]))
+			continue;
+		applied[setting] = requested[setting];
+		printf("Skipped %s, already %u\n", get_setting_name(setting), requested[setting]);
+		requested[setting] = UINT32_MAX;
+	}
+
+	adjerr = apply_settings_transaction(ry, requested, ATOMIC_VERIFY_MS, &failed);
+	if (adjerr) {
+		printf("Failed to apply %s: %d, all limits rolled back\n", failed >= 0 ? get_setting_name(failed) : "settings", adjerr);
+		*err = -1;
+		return;
+	}
+
+	for (setting = 0; setting < ADJ_SETTING_COUNT; setting++) {
+		if (requested[setting] == UINT32_MAX)
+			continue;
+		*any_adjust_applied = 1;
+		applied[setting] = requested[setting];
+		if (is_setting_switch(setting))
+			printf("Successfully enable %s\n", get_setting_name(setting));
+		else
+			printf("Successfully set %s to %u\n", get_setting_name(setting), requested[setting]);
+	}
+}
+
 static const char *family_name(enum ryzen_family fam)
 {
 	switch (fam) {
@@ -94,6 +229,25 @@ static void show_info_header(ryzen_access ry)
 	printf("Version: v" STRINGIFY(RYZENADJ_REVISION_VER) "." STRINGIFY(RYZENADJ_MAJOR_VER) "." STRINGIFY(RYZENADJ_MINIOR_VER) " \n");
 }
 
+static void show_self_stats(ryzen_access ry)
+{
+	struct ryzen_self_stats stats;
+
+	get_self_stats(ry, &stats);
+	printf("|        Counter      |       Value       |\n");
+	printf("|---------------------|-------------------|\n");
+	char statsFormat[] = "| %-19s | %17llu |\n";
+	printf(statsFormat, "MP1 Messages", (unsigned long long)stats.smu_messages[ADJ_MAILBOX_MP1]);
+	printf(statsFormat, "PSMU Messages", (unsigned long long)stats.smu_messages[ADJ_MAILBOX_PSMU]);
+	printf(statsFormat, "SMN Reads", (unsigned long long)stats.smn_reads);
+	printf(statsFormat, "SMN Writes", (unsigned long long)stats.smn_writes);
+	printf(statsFormat, "Syscalls", (unsigned long long)stats.syscalls);
+	printf(statsFormat, "Bytes Copied", (unsigned long long)stats.bytes_copied);
+	printf(statsFormat, "Table Refreshes", (unsigned long long)stats.refreshes);
+	printf(statsFormat, "Retries", (unsigned long long)stats.retries);
+	printf("| %-19s | %14.3lf ms |\n", "CPU Time", stats.cpu_time_ns / 1e6);
+}
+
 static void show_info_table(ryzen_access ry)
 {
 	printf("PM Table Version: %x\n", get_table_ver(ry));
@@ -188,13 +342,66 @@ static void show_table_dump(ryzen_access ry, int any_adjust_applied)
 	//don't free current_table_values because this would deinitialize our table
 }
 
+static void show_table_diff(ryzen_access ry)
+{
+	size_t index, table_size, count;
+	float *current_table_values, *old_table_values;
+	struct ryzen_table_diff *changes;
+
+	printf("PM Table Diff of Version: %x\n", get_table_ver(ry));
+	table_size = get_table_size(ry);
+
+	//copy old values before refresh
+	current_table_values = get_table_values(ry);
+	old_table_values = malloc(table_size);
+	changes = malloc(table_size / 4 * sizeof(*changes));
+	if (!old_table_values || !changes) {
+		free(old_table_values);
+		free(changes);
+		return;
+	}
+	memcpy(old_table_values, current_table_values, table_size);
+
+	int errorcode = refresh_table(ry);
+	if(errorcode){
+		printf("Unable to refresh power metric table: %d\n", errorcode);
+	}
+
+	count = diff_table_values(old_table_values, current_table_values, table_size, 0, 0, changes, table_size / 4);
+
+	//print table in github markdown
+	printf("| Offset |   Value   | After Adjust |\n");
+	printf("|--------|-----------|--------------|\n");
+	char tableFormat[] = "| 0x%04X | %9.3lf | %12.3lf |\n";
+	for(index = 0; index < count; index++)
+	{
+		printf(tableFormat, changes[index].offset, changes[index].old_value, changes[index].new_value);
+	}
+	printf("%zu of %zu entries changed\n", count, table_size / 4);
+
+	free(changes);
+	free(old_table_values);
+}
+
+//the library is silent by itself, print its messages like it used to, or all to ctx if given
+static void CALL print_log(void *ctx, enum ryzen_log_level level, int error, const char *message)
+{
+	fprintf(ctx ? ctx : level >= ADJ_LOG_INFO ? stderr : stdout, "%s\n", message);
+}
 
 int main(int argc, const char **argv)
 {
 	ryzen_access ry;
 	int err = 0;
 
-	int info = 0, dump_table = 0, any_adjust_applied = 0;
+	int info = 0, dump_table = 0, dump_table_diff = 0, use_cache = 0, any_adjust_applied = 0;
+	const char *trace_file = NULL;
+	int self_stats = 0, skip_unchanged = 0, atomic = 0, session = 0, batch = 0;
+	const char *profile_path = NULL, *profile_section = NULL;
+	const char *monitor_format = NULL;
+	struct monitor_options monitor = { -1, 0, MONITOR_CSV, NULL, NULL };
+	uint32_t hold_interval = -1;
+	uint32_t applied[ADJ_SETTING_COUNT], requested[ADJ_SETTING_COUNT];
 	int power_saving = 0, max_performance = 0, enable_oc = 0x0, disable_oc = 0x0;
 	//init unsigned types with max value because we treat max value as unset
 	uint32_t stapm_limit = -1, fast_limit = -1, slow_limit = -1, slow_time = -1, stapm_time = -1, tctl_temp = -1;
@@ -211,6 +418,22 @@ int main(int argc, const char **argv)
 		OPT_GROUP("Options"),
 		OPT_BOOLEAN('i', "info", &info, "Show information and most important power metrics after adjustment"),
 		OPT_BOOLEAN('\0', "dump-table", &dump_table, "Show whole power metric table before and after adjustment"),
+		OPT_BOOLEAN('\0', "dump-table-diff", &dump_table_diff, "Show only power metric table entries changed by the adjustment"),
+		OPT_STRING('\0', "trace", &trace_file, "Write a Chrome/Perfetto trace of all SMU traffic to this file"),
+		OPT_BOOLEAN('\0', "stats", &self_stats, "Show SMU messages, SMN accesses, syscalls and CPU time used by ryzenadj itself"),
+		OPT_U32('\0', "monitor", &monitor.interval_ms, "Keep running after adjustment and stream PM table samples every INTERVAL ms"),
+		OPT_STRING('\0', "monitor-format", &monitor_format, "Monitor output format: csv (default), jsonl or bin (recording, needs --monitor-output)"),
+		OPT_STRING('\0', "monitor-output", &monitor.output, "Write monitor samples to this file instead of stdout"),
+		OPT_STRING('\0', "monitor-fields", &monitor.fields, "Comma separated PM table byte offsets to monitor, e.g. 0x0,0x8 (default: whole table)"),
+		OPT_U32('\0', "monitor-count", &monitor.count, "Stop monitoring after this many samples (default: until interrupted)"),
+		OPT_U32('\0', "hold", &hold_interval, "Keep running and re-apply limits overridden by firmware or other tools, checked every INTERVAL ms"),
+		OPT_STRING('\0', "profile", &profile_path, "Apply the settings of this INI profile file before the ones given on the command line"),
+		OPT_STRING('\0', "profile-section", &profile_section, "Use the [section] of the profile file instead of the keys outside any section"),
+		OPT_BOOLEAN('\0', "atomic", &atomic, "Verify all settings in the PM table, restore the previous limits if any of them fails"),
+		OPT_BOOLEAN('\0', "session", &session, "Run the command after -- with the settings, then restore the limits in effect before"),
+		OPT_BOOLEAN('\0', "batch", &batch, "Read set, get, refresh and dump commands from stdin and answer each on one line of stdout"),
+		OPT_BOOLEAN('\0', "skip-unchanged", &skip_unchanged, "Read the current limits from the PM table and skip settings already in effect"),
+		OPT_BOOLEAN('\0', "cache", &use_cache, "Cache SMU init results and unsupported SMU messages in $RYZENADJ_CACHE_DIR (default /var/cache/ryzenadj)"),
 		OPT_GROUP("Settings"),
 		OPT_U32('a', "stapm-limit", &stapm_limit, "Sustained Power Limit         - STAPM LIMIT (mW)"),
 		OPT_U32('b', "fast-limit", &fast_limit, "Actual Power Limit            - PPT LIMIT FAST (mW)"),
@@ -264,28 +487,30 @@ int main(int argc, const char **argv)
 	argparse_describe(&argparse, "\n Ryzen Power Management adjust tool.", "\nWARNING: Use at your own risk!\nBy Jiaxun Yang <jiaxun.yang@flygoat.com>, Under LGPL.\nVersion: v" STRINGIFY(RYZENADJ_REVISION_VER) "." STRINGIFY(RYZENADJ_MAJOR_VER) "." STRINGIFY(RYZENADJ_MINIOR_VER));
 	argc = argparse_parse(&argparse, argc, argv);
 
-
-	//init RyzenAdj and validate that it was able to
-	ry = init_ryzenadj();
-	if(!ry){
-		printf("Unable to init ryzenadj\n");
+	if (monitor_format && parse_monitor_format(monitor_format, &monitor.format)) {
+		printf("Unknown monitor format %s\n", monitor_format);
 		return -1;
 	}
-
-	//shows info header before init_table
-	if (info) {
-		show_info_header(ry);
+	if (monitor.interval_ms == 0 || hold_interval == 0) {
+		printf("--monitor and --hold intervals must be positive\n");
+		return -1;
 	}
-
-	if (info || dump_table) {
-		//init before adjustment to get the default values
-		err = init_table(ry);
-		if (err) {
-			printf("Unable to init power metric table: %d, this does not affect adjustments because it is only needed for monitoring.\n", err);
-		}
+	if (monitor.interval_ms != -1 && hold_interval != -1) {
+		printf("--monitor and --hold can't be combined\n");
+		return -1;
+	}
+	if (session != (argc > 0)) {
+		printf(session ? "--session needs a command after --\n" : "A command after -- needs --session\n");
+		return -1;
 	}
+	if (session && (atomic || monitor.interval_ms != -1 || hold_interval != -1)) {
+		printf("--session can't be combined with --atomic, --monitor or --hold\n");
+		return -1;
+	}
+	memset(applied, 0xFF, sizeof(applied));
+	memset(requested, 0xFF, sizeof(requested));
 
-	//adjust all the arguments sent to RyzenAdj.exe
+	//collect all the arguments sent to RyzenAdj.exe
 	_do_adjust(stapm_limit);
 	_do_adjust(fast_limit);
 	_do_adjust(slow_limit);
@@ -329,10 +554,78 @@ int main(int argc, const char **argv)
 	_do_adjust(coper);
 	_do_adjust(cogfx);
 
+	//anything printed besides the answers would confuse the client
+	if (batch && (count_requested(requested) || profile_path || session || info || dump_table || dump_table_diff ||
+		      monitor.interval_ms != -1 || hold_interval != -1)) {
+		printf("--batch can't be combined with settings, profiles or other modes\n");
+		return -1;
+	}
+
+	//stdout of --batch carries only the answers
+	set_log_callback(print_log, batch ? stderr : NULL, ADJ_LOG_INFO);
+
+	//init RyzenAdj and validate that it was able to
+	ry = use_cache ? init_ryzenadj_cached(NULL) : init_ryzenadj();
+	if(!ry){
+		printf("Unable to init ryzenadj\n");
+		return -1;
+	}
+
+	if (use_cache) {
+		err = enable_capability_cache(ry, NULL);
+		if (err) {
+			printf("Unable to use capability cache: %d\n", err);
+			err = 0;
+		}
+	}
+
+	if (trace_file) {
+		err = enable_trace(ry, 4096);
+		if (err) {
+			printf("Unable to enable trace: %d\n", err);
+			err = 0;
+		}
+	}
+
+	//shows info header before init_table
+	if (info) {
+		show_info_header(ry);
+	}
+
+	if (info || dump_table || dump_table_diff || skip_unchanged) {
+		//init before adjustment to get the default values
+		err = init_table(ry);
+		if (err) {
+			printf("Unable to init power metric table: %d, this does not affect adjustments because it is only needed for monitoring.\n", err);
+			//without current limits nothing can be skipped
+			skip_unchanged = 0;
+		}
+	}
+
+	if (session) {
+		//the session captures the limits itself and skips those already in effect
+		if (profile_path && merge_profile(ry, profile_path, profile_section, requested))
+			err = -1;
+		else
+			err = run_session(ry, requested, argv);
+	} else if (atomic) {
+		//profile and command line go into one transaction
+		if (profile_path && merge_profile(ry, profile_path, profile_section, requested))
+			err = -1;
+		else if (count_requested(requested))
+			apply_atomic(ry, requested, skip_unchanged, applied, &any_adjust_applied, &err);
+	} else {
+		if (profile_path)
+			apply_profile_file(ry, profile_path, profile_section, applied, &any_adjust_applied, &err);
+		apply_requested(ry, requested, skip_unchanged, applied, &any_adjust_applied, &err);
+	}
+
 	if (!err) {
 		//call show table dump before anybody did call table refresh, because we want to copy the old values first
 		if (dump_table) {
 			show_table_dump(ry, any_adjust_applied);
+		} else if (dump_table_diff) {
+			show_table_diff(ry);
 		}
 		//show power table after apply settings
 		if (info) {
@@ -340,6 +633,30 @@ int main(int argc, const char **argv)
 		}
 	}
 
+	if (!err && hold_interval != -1) {
+		err = run_hold(ry, applied, hold_interval);
+		if (err)
+			printf("Hold failed: %d\n", err);
+	}
+
+	if (!err && monitor.interval_ms != -1) {
+		err = run_monitor(ry, &monitor);
+		if (err)
+			fprintf(stderr, "Monitor failed: %d\n", err);
+	}
+
+	if (!err && batch) {
+		err = run_batch(ry, stdin, stdout);
+		if (err)
+			fprintf(stderr, "Batch failed: %d\n", err);
+	}
+
+	if (trace_file && export_trace_json(ry, trace_file))
+		printf("Unable to write trace to %s\n", trace_file);
+
+	if (self_stats)
+		show_self_stats(ry);
+
 	cleanup_ryzenadj(ry);
 
 	return err;
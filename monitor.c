@@ -0,0 +1,266 @@
+// SPDX-License-Identifier: GPL-2.0
+/* ryzenadj --monitor, stream PM table samples */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "lib/ryzenadj_rec.h"
+#include "loop.h"
+#include "monitor.h"
+
+#define MAX_FIELDS 1024
+#define NS_PER_SEC 1000000000.0
+#define MONITOR_BUFFER_SIZE 65536
+//text output is written out at least this often so pipes don't stall
+#define MONITOR_FLUSH_NS 1000000000ull
+
+struct monitor {
+	const struct monitor_options *opts;
+	FILE *out;
+	rec_writer rec;
+	uint32_t offsets[MAX_FIELDS];
+	uint32_t count;
+	float *values;                   /* one sample, allocated once */
+	uint64_t first_ts;
+	uint64_t last_flush_ts;
+	uint64_t samples;
+	int err;
+	size_t len;
+	char buf[MONITOR_BUFFER_SIZE];
+};
+
+int parse_monitor_format(const char *name, enum monitor_format *format)
+{
+	if (!strcmp(name, "csv"))
+		*format = MONITOR_CSV;
+	else if (!strcmp(name, "jsonl"))
+		*format = MONITOR_JSONL;
+	else if (!strcmp(name, "bin"))
+		*format = MONITOR_BIN;
+	else
+		return ADJ_ERR_INVALID_ARG;
+
+	return 0;
+}
+
+static int parse_offsets(const char *list, uint32_t *offsets, const int max)
+{
+	const char *p = list;
+	char *end;
+	int count = 0;
+
+	while (*p && count < max) {
+		offsets[count++] = strtoul(p, &end, 0);
+		if (end == p || (*end && *end != ','))
+			return -1;
+		p = *end ? end + 1 : end;
+	}
+
+	return count;
+}
+
+static void flush_output(struct monitor *m)
+{
+	if (m->len && fwrite(m->buf, 1, m->len, m->out) != m->len)
+		m->err = ADJ_ERR_MEMORY_ACCESS;
+	m->len = 0;
+	if (fflush(m->out))
+		m->err = ADJ_ERR_MEMORY_ACCESS;
+}
+
+static void out_printf(struct monitor *m, const char *fmt, ...)
+{
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(m->buf + m->len, sizeof(m->buf) - m->len, fmt, ap);
+	va_end(ap);
+	if (len >= 0 && (size_t)len >= sizeof(m->buf) - m->len) {
+		//did not fit, write out what we have and format again into the empty buffer
+		flush_output(m);
+		va_start(ap, fmt);
+		len = vsnprintf(m->buf, sizeof(m->buf), fmt, ap);
+		va_end(ap);
+	}
+	if (len > 0)
+		m->len += len;
+}
+
+static void write_header(struct monitor *m)
+{
+	uint32_t i;
+
+	if (m->opts->format != MONITOR_CSV)
+		return;
+
+	out_printf(m, "time");
+	for (i = 0; i < m->count; i++)
+		out_printf(m, ",0x%04X", m->offsets[i]);
+	out_printf(m, "\n");
+}
+
+static void write_sample(struct monitor *m, const uint64_t timestamp_ns)
+{
+	const double time = (timestamp_ns - m->first_ts) / NS_PER_SEC;
+	uint32_t i;
+
+	switch (m->opts->format) {
+	case MONITOR_CSV:
+		out_printf(m, "%.3lf", time);
+		for (i = 0; i < m->count; i++)
+			out_printf(m, ",%g", m->values[i]);
+		out_printf(m, "\n");
+		break;
+	case MONITOR_JSONL:
+		out_printf(m, "{\"time\":%.3lf", time);
+		for (i = 0; i < m->count; i++) {
+			//JSON has no NaN or infinity
+			if (isfinite(m->values[i]))
+				out_printf(m, ",\"0x%04X\":%g", m->offsets[i], m->values[i]);
+			else
+				out_printf(m, ",\"0x%04X\":null", m->offsets[i]);
+		}
+		out_printf(m, "}\n");
+		break;
+	case MONITOR_BIN:
+		if (rec_writer_append(m->rec, timestamp_ns, m->values))
+			m->err = ADJ_ERR_MEMORY_ACCESS;
+		return;
+	}
+
+	if (timestamp_ns - m->last_flush_ts >= MONITOR_FLUSH_NS) {
+		flush_output(m);
+		m->last_flush_ts = timestamp_ns;
+	}
+}
+
+static void CALL monitor_sample(ryzen_access ry, int result, void *ctx)
+{
+	struct monitor *m = ctx;
+	uint64_t timestamp_ns;
+
+	if (result) {
+		fprintf(stderr, "Unable to refresh power metric table: %d\n", result);
+		return;
+	}
+
+	//the history holds the sample and the time of its refresh, copied into our buffer
+	if (get_table_history_entry(ry, get_table_history_seq(ry), m->values, &timestamp_ns))
+		return;
+
+	if (!m->samples++) {
+		m->first_ts = timestamp_ns;
+		m->last_flush_ts = timestamp_ns;
+	}
+	write_sample(m, timestamp_ns);
+
+	if (m->err || (m->opts->count && m->samples >= m->opts->count))
+		loop_stop = 1;
+}
+
+static int setup_monitor(ryzen_access ry, struct monitor *m)
+{
+	const size_t table_size = get_table_size(ry);
+	int count, errorcode;
+	uint32_t i;
+
+	if (m->opts->fields) {
+		if (m->opts->format == MONITOR_BIN) {
+			fprintf(stderr, "--monitor-fields is not supported by the bin format, it records the whole table\n");
+			return ADJ_ERR_INVALID_ARG;
+		}
+		count = parse_offsets(m->opts->fields, m->offsets, MAX_FIELDS);
+		if (count <= 0) {
+			fprintf(stderr, "Invalid --monitor-fields list\n");
+			return ADJ_ERR_INVALID_ARG;
+		}
+		m->count = count;
+	} else {
+		m->count = table_size / 4 < MAX_FIELDS ? table_size / 4 : MAX_FIELDS;
+		for (i = 0; i < m->count; i++)
+			m->offsets[i] = i * 4;
+	}
+
+	//the history copies only our fields, a capacity of 2 is enough as we read every sample right away
+	errorcode = enable_table_history(ry, 2, m->opts->fields ? m->offsets : NULL, m->opts->fields ? m->count : 0);
+	if (errorcode) {
+		fprintf(stderr, "Invalid PM table offset in --monitor-fields\n");
+		return errorcode;
+	}
+
+	m->values = malloc(m->opts->fields ? m->count * sizeof(float) : table_size);
+	if (!m->values)
+		return ADJ_ERR_OUT_OF_MEMORY;
+
+	if (m->opts->format == MONITOR_BIN) {
+		if (!m->opts->output) {
+			fprintf(stderr, "The bin format needs --monitor-output\n");
+			return ADJ_ERR_INVALID_ARG;
+		}
+		m->rec = rec_writer_open(m->opts->output, get_table_ver(ry), table_size, get_cpu_family(ry), 0);
+		if (!m->rec) {
+			fprintf(stderr, "Unable to create recording %s\n", m->opts->output);
+			return ADJ_ERR_MEMORY_ACCESS;
+		}
+		return 0;
+	}
+
+	if (m->opts->output) {
+		m->out = fopen(m->opts->output, "w");
+		if (!m->out) {
+			fprintf(stderr, "Unable to open %s\n", m->opts->output);
+			return ADJ_ERR_MEMORY_ACCESS;
+		}
+	} else {
+		//whatever the adjustments printed goes first
+		fflush(stdout);
+		m->out = stdout;
+	}
+
+	return 0;
+}
+
+int run_monitor(ryzen_access ry, const struct monitor_options *opts)
+{
+	struct monitor *m;
+	int errorcode;
+
+	if (!opts->interval_ms)
+		return ADJ_ERR_INVALID_ARG;
+
+	m = calloc(1, sizeof(*m));
+	if (!m)
+		return ADJ_ERR_OUT_OF_MEMORY;
+	m->opts = opts;
+
+	errorcode = setup_monitor(ry, m);
+	if (errorcode)
+		goto out;
+
+	write_header(m);
+
+	//refreshes run on a fixed grid of absolute deadlines, a slow sample doesn't shift the next ones
+	ryzenadj_schedule_refresh(ry, opts->interval_ms, monitor_sample, m);
+	run_loop(ry);
+	ryzenadj_schedule_refresh(ry, 0, NULL, NULL);
+	errorcode = m->err;
+
+out:
+	if (m->rec && rec_writer_close(m->rec) && !errorcode)
+		errorcode = ADJ_ERR_MEMORY_ACCESS;
+	if (m->out) {
+		flush_output(m);
+		if (!errorcode)
+			errorcode = m->err;
+		if (m->out != stdout)
+			fclose(m->out);
+	}
+	disable_table_history(ry);
+	free(m->values);
+	free(m);
+	return errorcode;
+}
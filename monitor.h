@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: GPL-2.0
+/* ryzenadj --monitor, stream PM table samples */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "lib/ryzenadj.h"
+
+enum monitor_format {
+	MONITOR_CSV = 0,
+	MONITOR_JSONL,
+	MONITOR_BIN,                     /* recording file, see lib/ryzenadj_rec.h */
+};
+
+struct monitor_options {
+	uint32_t interval_ms;
+	uint32_t count;                  /* stop after this many samples, 0: until interrupted */
+	enum monitor_format format;
+	const char *output;              /* NULL: stdout */
+	const char *fields;              /* comma separated byte offsets, NULL: whole table */
+};
+
+int parse_monitor_format(const char *name, enum monitor_format *format);
+
+/* sample until count is reached or SIGINT/SIGTERM, returns 0 or a negative error */
+int run_monitor(ryzen_access ry, const struct monitor_options *opts);
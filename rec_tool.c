@@ -0,0 +1,203 @@
+// SPDX-License-Identifier: LGPL
+/* RyzenAdj PM table recording query tool */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib/ryzenadj_rec.h"
+#include "argparse.h"
+
+#define MAX_FIELDS 1024
+#define NS_PER_SEC 1000000000.0
+#define MAX_BUCKETS (1u << 24)
+
+static const char *const usage[] = {
+	"ryzenadj-rec [options] <recording>",
+	NULL,
+};
+
+static int parse_offsets(const char *list, uint32_t *offsets, const int max)
+{
+	const char *p = list;
+	char *end;
+	int count = 0;
+
+	while (*p && count < max) {
+		offsets[count++] = strtoul(p, &end, 0);
+		if (end == p || (*end && *end != ','))
+			return -1;
+		p = *end ? end + 1 : end;
+	}
+
+	return count;
+}
+
+static uint64_t to_ns(const rec_reader r, const float seconds, const uint64_t fallback)
+{
+	if (seconds < 0)
+		return fallback;
+	return rec_reader_first_ts(r) + (uint64_t)(seconds * NS_PER_SEC);
+}
+
+static void show_info(rec_reader r)
+{
+	const double duration = (rec_reader_last_ts(r) - rec_reader_first_ts(r)) / NS_PER_SEC;
+
+	printf("PM Table Version: %x\n", rec_reader_table_ver(r));
+	printf("PM Table Size: %u\n", rec_reader_table_size(r));
+	printf("CPU Family: %d\n", rec_reader_family(r));
+	printf("Frames: %llu\n", (unsigned long long)rec_reader_frame_count(r));
+	printf("Duration: %.3lf s\n", duration);
+}
+
+struct csv_ctx {
+	uint64_t first_ts;
+	int count;
+};
+
+static int print_csv_frame(void *ctx, uint64_t timestamp_ns, const float *values)
+{
+	const struct csv_ctx *csv = ctx;
+	int i;
+
+	printf("%.3lf", (timestamp_ns - csv->first_ts) / NS_PER_SEC);
+	for (i = 0; i < csv->count; i++)
+		printf(",%g", values[i]);
+	putchar('\n');
+	return 0;
+}
+
+static int export_csv(rec_reader r, const uint32_t *offsets, const int count, const uint64_t t0, const uint64_t t1)
+{
+	struct csv_ctx csv = { rec_reader_first_ts(r), count };
+	int i;
+
+	printf("time");
+	for (i = 0; i < count; i++)
+		printf(",0x%04X", offsets[i]);
+	putchar('\n');
+
+	return rec_read_fields(r, t0, t1, offsets, count, print_csv_frame, &csv);
+}
+
+static int show_aggregate(rec_reader r, const uint32_t offset, const char *mode, const float bucket,
+			  const uint64_t t0, const uint64_t t1, const int threads)
+{
+	const uint64_t bucket_ns = (uint64_t)(bucket * NS_PER_SEC);
+	struct rec_bucket_stats *stats;
+	uint64_t buckets;
+	uint32_t count, i;
+	int err;
+
+	if (!bucket_ns) {
+		printf("--bucket must be positive\n");
+		return -1;
+	}
+	if (t0 > t1) {
+		printf("--from must not be after --to\n");
+		return -1;
+	}
+
+	buckets = (t1 - t0) / bucket_ns + 1;
+	if (buckets > MAX_BUCKETS) {
+		printf("Range needs %llu buckets, use a larger --bucket\n", (unsigned long long)buckets);
+		return -1;
+	}
+	count = (uint32_t)buckets;
+	stats = calloc(count, sizeof(*stats));
+	if (!stats)
+		return -1;
+
+	err = rec_aggregate(r, offset, t0, t1, bucket_ns, stats, count, threads);
+	if (!err) {
+		printf("time,count,min,max,mean\n");
+		for (i = 0; i < count; i++) {
+			if (!stats[i].count)
+				continue;
+			printf("%.3lf,%u,", (stats[i].start_ns - rec_reader_first_ts(r)) / NS_PER_SEC, stats[i].count);
+			if (!strcmp(mode, "min"))
+				printf("%g,,\n", stats[i].min);
+			else if (!strcmp(mode, "max"))
+				printf(",%g,\n", stats[i].max);
+			else if (!strcmp(mode, "mean"))
+				printf(",,%g\n", stats[i].mean);
+			else
+				printf("%g,%g,%g\n", stats[i].min, stats[i].max, stats[i].mean);
+		}
+	}
+
+	free(stats);
+	return err;
+}
+
+int main(int argc, const char **argv)
+{
+	int info = 0, threads = 0, field_count = 0, err = 0;
+	float from = -1, to = -1, bucket = 60;
+	const char *fields = NULL, *aggregate = NULL;
+	uint32_t offsets[MAX_FIELDS];
+	uint64_t t0, t1;
+	rec_reader r;
+
+	struct argparse_option options[] = {
+		OPT_HELP(),
+		OPT_GROUP("Options"),
+		OPT_BOOLEAN('i', "info", &info, "Show recording header and duration"),
+		OPT_STRING('f', "fields", &fields, "Comma separated PM table offsets, e.g. 0x0,0x8,0x18; printed as CSV"),
+		OPT_FLOAT('\0', "from", &from, "Start of the time range in seconds since start of recording"),
+		OPT_FLOAT('\0', "to", &to, "End of the time range in seconds since start of recording"),
+		OPT_STRING('a', "aggregate", &aggregate, "Reduce a single field per bucket: min, max, mean or all"),
+		OPT_FLOAT('b', "bucket", &bucket, "Bucket length in seconds for --aggregate (default 60)"),
+		OPT_INTEGER('j', "threads", &threads, "Worker threads for --aggregate (default all CPUs)"),
+		OPT_END(),
+	};
+
+	struct argparse argparse;
+	argparse_init(&argparse, options, usage, 0);
+	argparse_describe(&argparse, "\n Query RyzenAdj PM table recordings.", NULL);
+	argc = argparse_parse(&argparse, argc, argv);
+
+	if (argc != 1) {
+		argparse_usage(&argparse);
+		return -1;
+	}
+
+	if (fields) {
+		field_count = parse_offsets(fields, offsets, MAX_FIELDS);
+		if (field_count <= 0) {
+			printf("Invalid --fields list: %s\n", fields);
+			return -1;
+		}
+	}
+
+	r = rec_reader_open(argv[0]);
+	if (!r) {
+		printf("Unable to open recording %s\n", argv[0]);
+		return -1;
+	}
+
+	t0 = to_ns(r, from, rec_reader_first_ts(r));
+	t1 = to_ns(r, to, rec_reader_last_ts(r));
+
+	if (info || (!field_count && !aggregate))
+		show_info(r);
+
+	if (aggregate) {
+		if (field_count != 1 || (strcmp(aggregate, "min") && strcmp(aggregate, "max") &&
+					 strcmp(aggregate, "mean") && strcmp(aggregate, "all"))) {
+			printf("--aggregate needs exactly one field and one of min, max, mean or all\n");
+			err = -1;
+		} else {
+			err = show_aggregate(r, offsets[0], aggregate, bucket, t0, t1, threads);
+		}
+	} else if (field_count) {
+		err = export_csv(r, offsets, field_count, t0, t1);
+	}
+
+	if (err)
+		printf("Query failed: %d\n", err);
+
+	rec_reader_close(r);
+	return err;
+}
@@ -0,0 +1,482 @@
+// SPDX-License-Identifier: GPL-2.0
+/* ryzenadjd, owns the SMU and serves the --batch commands on a Unix socket */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "lib/ryzenadj.h"
+#include "argparse.h"
+#include "batch.h"
+
+#define DEFAULT_SOCKET "/run/ryzenadjd.sock"
+#define MAX_CLIENTS 64
+#define CLIENT_LINE_SIZE 256
+//a client this far behind on reading is dropped instead of buffering without bound
+#define CLIENT_MAX_PENDING (1 << 20)
+
+struct client {
+	int fd;
+	int closed;
+	int discard;                     /* rest of a too long line */
+	size_t in_len;
+	char in[CLIENT_LINE_SIZE];
+	char *out;
+	size_t out_len;
+	size_t out_cap;
+	uint32_t interval_ms;            /* sample subscription, 0: none */
+	uint64_t next_sample_ns;
+};
+
+struct daemon {
+	ryzen_access ry;
+	int listen_fd;
+	uint32_t min_refresh_ms;
+	uint64_t last_refresh_ns;
+	uint32_t scheduled_ms;
+	uint32_t count;
+	struct client clients[MAX_CLIENTS];
+};
+
+static const char *const usage[] = {
+	"ryzenadjd [options]",
+	NULL,
+};
+
+static volatile sig_atomic_t stop;
+
+static void stop_daemon(int sig)
+{
+	stop = 1;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void client_append(struct client *c, const char *data, const size_t len)
+{
+	size_t cap = c->out_cap ? c->out_cap : 4096;
+	char *out;
+
+	if (c->closed)
+		return;
+	if (c->out_len + len > CLIENT_MAX_PENDING) {
+		fprintf(stderr, "Client %d does not read its answers, dropped\n", c->fd);
+		c->closed = 1;
+		return;
+	}
+	while (cap < c->out_len + len)
+		cap *= 2;
+	if (cap != c->out_cap) {
+		out = realloc(c->out, cap);
+		if (!out) {
+			c->closed = 1;
+			return;
+		}
+		c->out = out;
+		c->out_cap = cap;
+	}
+	memcpy(c->out + c->out_len, data, len);
+	c->out_len += len;
+}
+
+static void client_printf(struct client *c, const char *fmt, ...)
+{
+	char line[128];
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(line, sizeof(line), fmt, ap);
+	va_end(ap);
+	if (len > 0)
+		client_append(c, line, (size_t)len < sizeof(line) ? len : sizeof(line) - 1);
+}
+
+static void client_flush(struct client *c)
+{
+	ssize_t sent;
+
+	if (!c->out_len)
+		return;
+	sent = send(c->fd, c->out, c->out_len, MSG_NOSIGNAL | MSG_DONTWAIT);
+	if (sent < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			c->closed = 1;
+		return;
+	}
+	memmove(c->out, c->out + sent, c->out_len - sent);
+	c->out_len -= sent;
+}
+
+static void CALL on_refresh(ryzen_access ry, int result, void *ctx);
+
+//one shared refresh serves every subscriber, at the pace of the fastest
+static void update_schedule(struct daemon *d)
+{
+	uint32_t i, interval = 0;
+
+	for (i = 0; i < d->count; i++) {
+		if (d->clients[i].interval_ms && (!interval || d->clients[i].interval_ms < interval))
+			interval = d->clients[i].interval_ms;
+	}
+	if (interval != d->scheduled_ms) {
+		ryzenadj_schedule_refresh(d->ry, interval, interval ? on_refresh : NULL, d);
+		d->scheduled_ms = interval;
+	}
+}
+
+static void CALL on_refresh(ryzen_access ry, int result, void *ctx)
+{
+	struct daemon *d = ctx;
+	const uint64_t now = now_ns();
+	struct client *c;
+	char *sample = NULL;
+	size_t len = 0;
+	FILE *f;
+	uint32_t i;
+
+	if (result) {
+		fprintf(stderr, "Unable to refresh power metric table: %d\n", result);
+		return;
+	}
+	d->last_refresh_ns = now;
+
+	for (i = 0; i < d->count; i++) {
+		c = &d->clients[i];
+		if (!c->interval_ms || c->next_sample_ns > now)
+			continue;
+		//formatted once for all subscribers due
+		if (!sample) {
+			f = open_memstream(&sample, &len);
+			if (!f)
+				return;
+			batch_write_table(ry, f, "sample");
+			fclose(f);
+		}
+		client_append(c, sample, len);
+		c->next_sample_ns += (uint64_t)c->interval_ms * 1000000;
+		if (c->next_sample_ns <= now)
+			c->next_sample_ns = now + (uint64_t)c->interval_ms * 1000000;
+	}
+	free(sample);
+}
+
+//tables younger than min_refresh_ms are shared instead of asking the SMU again
+static int refresh_shared(struct daemon *d)
+{
+	const uint64_t now = now_ns();
+	int err;
+
+	if (d->last_refresh_ns && now - d->last_refresh_ns < (uint64_t)d->min_refresh_ms * 1000000)
+		return 0;
+	err = refresh_table(d->ry);
+	if (!err)
+		d->last_refresh_ns = now;
+	return err;
+}
+
+static void answer(struct daemon *d, struct client *c, char *line)
+{
+	char cmd[16], *text = NULL;
+	size_t len = 0;
+	unsigned long interval;
+	int err, n = 0;
+	FILE *f;
+
+	//commands of the daemon itself, everything else is answered like --batch does
+	if (sscanf(line, " %15s %n", cmd, &n) == 1) {
+		if (!strcmp(cmd, "refresh") && !line[n]) {
+			err = refresh_shared(d);
+			if (err)
+				client_printf(c, "error %d refresh failed\n", err);
+			else
+				client_printf(c, "ok\n");
+			return;
+		}
+		if (!strcmp(cmd, "subscribe") && sscanf(line + n, "%lu", &interval) == 1 && interval <= UINT32_MAX) {
+			c->interval_ms = interval && interval < d->min_refresh_ms ? d->min_refresh_ms : interval;
+			c->next_sample_ns = now_ns();
+			update_schedule(d);
+			client_printf(c, "ok\n");
+			return;
+		}
+	}
+
+	f = open_memstream(&text, &len);
+	if (!f) {
+		c->closed = 1;
+		return;
+	}
+	if (batch_command(d->ry, f, line))
+		c->closed = 1;
+	fclose(f);
+	client_append(c, text, len);
+	free(text);
+}
+
+static void client_read(struct daemon *d, struct client *c)
+{
+	char buf[4096];
+	ssize_t n, i;
+
+	n = recv(c->fd, buf, sizeof(buf), MSG_DONTWAIT);
+	if (n <= 0) {
+		if (!n || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+			c->closed = 1;
+		return;
+	}
+
+	for (i = 0; i < n && !c->closed; i++) {
+		if (buf[i] != '\n') {
+			if (c->in_len < sizeof(c->in) - 1)
+				c->in[c->in_len++] = buf[i];
+			else
+				c->discard = 1;
+			continue;
+		}
+		if (c->discard)
+			client_printf(c, "error %d line too long\n", ADJ_ERR_INVALID_ARG);
+		else {
+			c->in[c->in_len] = '\0';
+			answer(d, c, c->in);
+		}
+		c->in_len = 0;
+		c->discard = 0;
+	}
+}
+
+static void accept_clients(struct daemon *d)
+{
+	struct client *c;
+	int fd;
+
+	for (;;) {
+		fd = accept(d->listen_fd, NULL, NULL);
+		if (fd < 0)
+			return;
+		if (d->count == MAX_CLIENTS) {
+			fprintf(stderr, "Too many clients, refused one\n");
+			close(fd);
+			continue;
+		}
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+		c = &d->clients[d->count++];
+		memset(c, 0, sizeof(*c));
+		c->fd = fd;
+	}
+}
+
+static void remove_closed(struct daemon *d)
+{
+	uint32_t i = 0;
+	int subscribed = 0;
+
+	while (i < d->count) {
+		if (!d->clients[i].closed) {
+			i++;
+			continue;
+		}
+		subscribed |= d->clients[i].interval_ms != 0;
+		//answers before "quit" still go out if the socket takes them
+		client_flush(&d->clients[i]);
+		close(d->clients[i].fd);
+		free(d->clients[i].out);
+		d->clients[i] = d->clients[--d->count];
+	}
+	if (subscribed)
+		update_schedule(d);
+}
+
+static int open_socket(const char *path, const char *mode, const char *group)
+{
+	struct sockaddr_un addr;
+	struct group *grp;
+	struct stat st;
+	unsigned long perm;
+	mode_t old_mask;
+	char *end;
+	int fd, err;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket path %s is too long\n", path);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+	perm = strtoul(mode, &end, 8);
+	if (*end || perm > 0777) {
+		fprintf(stderr, "Invalid socket mode %s\n", mode);
+		return -1;
+	}
+
+	//a socket left by a previous run, never any other file
+	if (!lstat(path, &st) && S_ISSOCK(st.st_mode))
+		unlink(path);
+
+	//owner only until mode and group are in place, nobody may connect in between
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	old_mask = umask(0177);
+	err = fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+	umask(old_mask);
+	if (err) {
+		fprintf(stderr, "Unable to listen on %s: %s\n", path, strerror(errno));
+		goto fail;
+	}
+
+	if (group) {
+		grp = getgrnam(group);
+		if (!grp || chown(path, -1, grp->gr_gid)) {
+			fprintf(stderr, "Unable to give %s to group %s\n", path, group);
+			goto fail;
+		}
+	}
+	if (chmod(path, perm)) {
+		fprintf(stderr, "Unable to set mode %s of %s: %s\n", mode, path, strerror(errno));
+		goto fail;
+	}
+	if (listen(fd, 16)) {
+		fprintf(stderr, "Unable to listen on %s: %s\n", path, strerror(errno));
+		goto fail;
+	}
+
+	return fd;
+
+fail:
+	if (fd >= 0)
+		close(fd);
+	return -1;
+}
+
+static void serve(struct daemon *d)
+{
+	struct pollfd pfd[MAX_CLIENTS + 2];
+	uint32_t i, timeout_ms;
+	int n;
+
+	while (!stop) {
+		ryzenadj_dispatch(d->ry, &timeout_ms);
+		for (i = 0; i < d->count; i++)
+			client_flush(&d->clients[i]);
+		remove_closed(d);
+
+		pfd[0].fd = d->listen_fd;
+		pfd[0].events = POLLIN;
+		pfd[1].fd = (int)ryzenadj_get_fd(d->ry);
+		pfd[1].events = POLLIN;
+		for (i = 0; i < d->count; i++) {
+			pfd[i + 2].fd = d->clients[i].fd;
+			pfd[i + 2].events = POLLIN | (d->clients[i].out_len ? POLLOUT : 0);
+		}
+
+		//signals interrupt poll, the loop then sees stop
+		n = poll(pfd, d->count + 2, timeout_ms == UINT32_MAX ? -1 : (int)timeout_ms);
+		if (n <= 0)
+			continue;
+
+		for (i = 0; i < d->count; i++) {
+			if (pfd[i + 2].revents & POLLIN)
+				client_read(d, &d->clients[i]);
+			else if (pfd[i + 2].revents & (POLLERR | POLLHUP))
+				d->clients[i].closed = 1;
+			client_flush(&d->clients[i]);
+		}
+		if (pfd[0].revents & POLLIN)
+			accept_clients(d);
+	}
+}
+
+//the library is silent by itself, a daemon logs to stderr
+static void CALL print_log(void *ctx, enum ryzen_log_level level, int error, const char *message)
+{
+	fprintf(stderr, "%s\n", message);
+}
+
+int main(int argc, const char **argv)
+{
+	const char *socket_path = DEFAULT_SOCKET, *socket_mode = "0660", *socket_group = NULL;
+	uint32_t min_refresh_ms = 100;
+	int use_cache = 0, err;
+	struct daemon *d;
+	uint32_t i;
+
+	struct argparse_option options[] = {
+		OPT_HELP(),
+		OPT_GROUP("Options"),
+		OPT_STRING('\0', "socket", &socket_path, "Listen on this Unix socket (default " DEFAULT_SOCKET ")"),
+		OPT_STRING('\0', "socket-mode", &socket_mode, "Octal permissions of the socket, whoever may connect may set limits (default 0660)"),
+		OPT_STRING('\0', "socket-group", &socket_group, "Give the socket to this group, e.g. for users without root"),
+		OPT_U32('\0', "min-refresh", &min_refresh_ms, "Clients share PM tables younger than this many ms (default 100)"),
+		OPT_BOOLEAN('\0', "cache", &use_cache, "Cache SMU init results and unsupported SMU messages in $RYZENADJ_CACHE_DIR (default /var/cache/ryzenadj)"),
+		OPT_END(),
+	};
+
+	struct argparse argparse;
+	argparse_init(&argparse, options, usage, ARGPARSE_NON_OPTION_IS_INVALID);
+	argparse_describe(&argparse, "\n Owns the SMU and serves ryzenadj --batch commands to local clients.", NULL);
+	//argparse shows the usage without any argument, the defaults are fine for a daemon
+	if (argc > 1)
+		argparse_parse(&argparse, argc, argv);
+
+	d = calloc(1, sizeof(*d));
+	if (!d)
+		return -1;
+	d->min_refresh_ms = min_refresh_ms;
+
+	set_log_callback(print_log, NULL, ADJ_LOG_INFO);
+	d->ry = use_cache ? init_ryzenadj_cached(NULL) : init_ryzenadj();
+	if (!d->ry) {
+		fprintf(stderr, "Unable to init ryzenadj\n");
+		free(d);
+		return -1;
+	}
+	if (use_cache && enable_capability_cache(d->ry, NULL))
+		fprintf(stderr, "Unable to use capability cache\n");
+
+	err = init_table(d->ry);
+	if (err)
+		fprintf(stderr, "Unable to init power metric table: %d, only set is available\n", err);
+
+	d->listen_fd = open_socket(socket_path, socket_mode, socket_group);
+	if (d->listen_fd < 0) {
+		cleanup_ryzenadj(d->ry);
+		free(d);
+		return -1;
+	}
+
+	signal(SIGINT, stop_daemon);
+	signal(SIGTERM, stop_daemon);
+	signal(SIGPIPE, SIG_IGN);
+
+	serve(d);
+
+	for (i = 0; i < d->count; i++) {
+		close(d->clients[i].fd);
+		free(d->clients[i].out);
+	}
+	close(d->listen_fd);
+	unlink(socket_path);
+	ryzenadj_schedule_refresh(d->ry, 0, NULL, NULL);
+	cleanup_ryzenadj(d->ry);
+	free(d);
+
+	return 0;
+}
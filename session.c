@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: GPL-2.0
+/* ryzenadj --session, run a command with temporary limits */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+#include "session.h"
+
+#ifdef _WIN32
+//quote argv the way CommandLineToArgvW splits it again
+static char *build_command_line(const char **argv)
+{
+	size_t size = 1, i;
+	const char **arg, *p;
+	char *line, *q;
+
+	for (arg = argv; *arg; arg++)
+		size += 2 * strlen(*arg) + 3;
+	line = malloc(size);
+	if (!line)
+		return NULL;
+
+	q = line;
+	for (arg = argv; *arg; arg++) {
+		if (arg != argv)
+			*q++ = ' ';
+		*q++ = '"';
+		for (p = *arg; *p; p++) {
+			//backslashes only escape when followed by a quote, which includes our closing one
+			for (i = 0; p[i] == '\\'; i++)
+				;
+			if (p[i] == '"' || !p[i]) {
+				memset(q, '\\', 2 * i);
+				q += 2 * i;
+				p += i;
+				if (!*p)
+					break;
+				*q++ = '\\';
+			} else if (i) {
+				memset(q, '\\', i);
+				q += i;
+				p += i;
+			}
+			*q++ = *p;
+		}
+		*q++ = '"';
+	}
+	*q = '\0';
+
+	return line;
+}
+
+//the command shares our console and gets Ctrl+C itself, we stay to restore the limits
+static BOOL WINAPI ignore_ctrl(DWORD type)
+{
+	return type == CTRL_C_EVENT || type == CTRL_BREAK_EVENT;
+}
+
+static int run_command(const char **argv)
+{
+	STARTUPINFOA si = { sizeof(si) };
+	PROCESS_INFORMATION pi;
+	DWORD status = 0;
+	char *line;
+
+	line = build_command_line(argv);
+	if (!line)
+		return ADJ_ERR_OUT_OF_MEMORY;
+
+	SetConsoleCtrlHandler(ignore_ctrl, TRUE);
+	if (!CreateProcessA(NULL, line, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi)) {
+		fprintf(stderr, "Unable to run %s: %lu\n", argv[0], GetLastError());
+		SetConsoleCtrlHandler(ignore_ctrl, FALSE);
+		free(line);
+		return 127;
+	}
+
+	WaitForSingleObject(pi.hProcess, INFINITE);
+	GetExitCodeProcess(pi.hProcess, &status);
+	CloseHandle(pi.hThread);
+	CloseHandle(pi.hProcess);
+	SetConsoleCtrlHandler(ignore_ctrl, FALSE);
+	free(line);
+
+	return (int)status;
+}
+#else
+static volatile pid_t child_pid;
+static volatile sig_atomic_t pending_signal;
+
+/*
+ * SIGINT from the terminal reaches the whole foreground group and thus the command
+ * already, forwarding it would deliver it twice. SIGTERM and SIGHUP are sent to us only.
+ */
+static void forward_signal(int sig)
+{
+	if (sig == SIGINT)
+		return;
+	if (child_pid > 0)
+		kill(child_pid, sig);
+	else
+		pending_signal = sig;
+}
+
+static int run_command(const char **argv)
+{
+	static const int signals[] = { SIGINT, SIGTERM, SIGHUP };
+	struct sigaction sa, old[3];
+	int status = 0, code = 127, i;
+	pid_t pid;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = forward_signal;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	for (i = 0; i < 3; i++)
+		sigaction(signals[i], &sa, &old[i]);
+
+	//whatever the adjustments printed goes first
+	fflush(stdout);
+	child_pid = 0;
+	pending_signal = 0;
+	pid = fork();
+	if (pid == 0) {
+		for (i = 0; i < 3; i++)
+			sigaction(signals[i], &old[i], NULL);
+		execvp(argv[0], (char *const *)argv);
+		fprintf(stderr, "Unable to run %s: %s\n", argv[0], strerror(errno));
+		_exit(127);
+	}
+
+	if (pid < 0) {
+		fprintf(stderr, "Unable to run %s: %s\n", argv[0], strerror(errno));
+	} else {
+		child_pid = pid;
+		//a signal that came before child_pid was set
+		if (pending_signal)
+			kill(pid, pending_signal);
+		while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+			;
+		child_pid = 0;
+		code = WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+	}
+
+	for (i = 0; i < 3; i++)
+		sigaction(signals[i], &old[i], NULL);
+
+	return code;
+}
+#endif
+
+int run_session(ryzen_access ry, const uint32_t *values, const char **argv)
+{
+	ryzen_session session;
+	int status, err;
+
+	session = begin_session(ry, &err);
+	if (!session) {
+		printf("Unable to capture current limits: %d\n", err);
+		return -1;
+	}
+
+	err = session_apply_settings(ry, session, values);
+	if (err)
+		printf("Some limits could not be applied: %d, running anyway\n", err);
+
+	status = run_command(argv);
+
+	err = end_session(ry, session);
+	if (err) {
+		printf("Unable to restore all limits: %d\n", err);
+		return SESSION_RESTORE_FAILED;
+	}
+	printf("Limits restored\n");
+
+	return status < 0 ? -1 : status;
+}
@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: GPL-2.0
+/* ryzenadj --session, run a command with temporary limits */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "lib/ryzenadj.h"
+
+/* exit status if the limits could not all be restored, like timeout(1) reports its own failure */
+#define SESSION_RESTORE_FAILED 125
+
+/*
+ * Capture the effective limits, apply values (-1: left alone), run argv and restore the
+ * captured limits once it exited or ryzenadj got SIGINT/SIGTERM/SIGHUP. Returns the exit
+ * status of the command, 128 + signal if it was killed, SESSION_RESTORE_FAILED if a limit
+ * could not be restored, or -1 if the session could not be started.
+ */
+int run_session(ryzen_access ry, const uint32_t *values, const char **argv);